@@ -0,0 +1,33 @@
+#ifndef benchmark_h_
+#define benchmark_h_
+
+#include <stdio.h>
+#include <time.h>
+
+// Runs a functor a few times and returns the best time in milliseconds.
+//
+// The functor is a struct with the method: void operator()();
+//
+// Example:
+//
+//   struct WriteVectors {
+//       void operator()() { ... }
+//   };
+//
+//   WriteVectors writeVectors;
+//   printf("write: %.2f ms\n", benchmarkBest(writeVectors, 10));
+//
+template <typename F>
+double benchmarkBest(F &f, int runs) {
+    double best = 1e30;
+    for (int i = 0; i < runs; i++) {
+        clock_t start = clock();
+        f();
+        double ms = (double)(clock() - start) * 1000.0 / (double)CLOCKS_PER_SEC;
+        if (ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+#endif
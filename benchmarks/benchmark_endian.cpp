@@ -0,0 +1,160 @@
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/aRibeiroData.h>
+#include <aRibeiroData/BinaryEndian.h>
+
+#include <string.h>
+
+#include "Benchmark.h"
+
+using namespace aRibeiro;
+
+// Cost of the little endian conversion of the binary streams.
+//
+//   native: the bytes copied in the host byte order (memcpy, readStrided)
+//   little endian: the BinaryEndian::load32 and the readVectorVec3 (readStrided + BinaryEndian::littleArray)
+//
+// In little endian hosts the conversion compiles to nothing: both need to have the same time.
+
+const uint32_t WordCount = 4000000;
+const uint32_t VertexCount = 2000000;
+const int Runs = 25;
+
+struct NativeUInt32 {
+    const uint8_t *data;
+    uint32_t sum;
+    void operator()() {
+        sum = 0;
+        for (uint32_t i = 0; i < WordCount; i++) {
+            uint32_t v;
+            memcpy(&v, data + i * sizeof(uint32_t), sizeof(uint32_t));
+            sum += v;
+        }
+    }
+};
+
+struct LittleUInt32 {
+    const uint8_t *data;
+    uint32_t sum;
+    void operator()() {
+        sum = 0;
+        for (uint32_t i = 0; i < WordCount; i++)
+            sum += BinaryEndian::load32(data + i * sizeof(uint32_t));
+    }
+};
+
+struct NativeFloat {
+    const uint8_t *data;
+    float sum;
+    void operator()() {
+        sum = 0;
+        for (uint32_t i = 0; i < WordCount; i++) {
+            float v;
+            memcpy(&v, data + i * sizeof(float), sizeof(float));
+            sum += v;
+        }
+    }
+};
+
+struct LittleFloat {
+    const uint8_t *data;
+    float sum;
+    void operator()() {
+        sum = 0;
+        for (uint32_t i = 0; i < WordCount; i++) {
+            // the same steps of the BinaryReader::readFloat
+            uint32_t bits = BinaryEndian::load32(data + i * sizeof(float));
+            float v;
+            memcpy(&v, &bits, sizeof(float));
+            sum += v;
+        }
+    }
+};
+
+struct NativeVec3 {
+    const std::vector<uint8_t> *data;
+    BinaryReader reader;
+    aligned_vector<vec3> output;
+    void operator()() {
+        reader.readFromBorrowedBuffer(&(*data)[0], data->size());
+        output.resize(reader.readUInt32());
+        reader.readStrided(&output[0], output.size(), sizeof(float) * 3, sizeof(vec3));
+        reader.close();
+    }
+};
+
+struct LittleVec3 {
+    const std::vector<uint8_t> *data;
+    BinaryReader reader;
+    aligned_vector<vec3> output;
+    void operator()() {
+        reader.readFromBorrowedBuffer(&(*data)[0], data->size());
+        reader.readVectorVec3(&output);
+        reader.close();
+    }
+};
+
+int main() {
+    BinaryWriter words;
+    words.writeToBuffer(false);
+    for (uint32_t i = 0; i < WordCount; i++)
+        words.writeUInt32(i * 2654435761u);
+    words.close();
+
+    BinaryWriter floats;
+    floats.writeToBuffer(false);
+    for (uint32_t i = 0; i < WordCount; i++)
+        floats.writeFloat((float)(i % 1024) * 0.25f);
+    floats.close();
+
+    aligned_vector<vec3> input;
+    input.resize(VertexCount);
+    for (uint32_t i = 0; i < VertexCount; i++)
+        input[i] = vec3((float)i, (float)i * 0.5f, (float)i * 0.25f);
+    BinaryWriter vertices;
+    vertices.writeToBuffer(false);
+    vertices.writeVectorVec3(input);
+    vertices.close();
+
+    NativeUInt32 nativeUInt32;
+    nativeUInt32.data = &words.buffer[0];
+    LittleUInt32 littleUInt32;
+    littleUInt32.data = &words.buffer[0];
+    NativeFloat nativeFloat;
+    nativeFloat.data = &floats.buffer[0];
+    LittleFloat littleFloat;
+    littleFloat.data = &floats.buffer[0];
+    NativeVec3 nativeVec3;
+    nativeVec3.data = &vertices.buffer;
+    LittleVec3 littleVec3;
+    littleVec3.data = &vertices.buffer;
+
+    double nativeUInt32Ms = benchmarkBest(nativeUInt32, Runs);
+    double littleUInt32Ms = benchmarkBest(littleUInt32, Runs);
+    double nativeFloatMs = benchmarkBest(nativeFloat, Runs);
+    double littleFloatMs = benchmarkBest(littleFloat, Runs);
+    double nativeVec3Ms = benchmarkBest(nativeVec3, Runs);
+    double littleVec3Ms = benchmarkBest(littleVec3, Runs);
+
+#if !ARIBEIRO_BINARY_BIG_ENDIAN
+    // in little endian hosts the native copy is the reference
+    if (nativeUInt32.sum != littleUInt32.sum || nativeFloat.sum != littleFloat.sum) {
+        printf("error: the native and the little endian values are different\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < VertexCount; i++) {
+        if (!(nativeVec3.output[i] == littleVec3.output[i])) {
+            printf("error: the native and the little endian vec3 are different at %u\n", i);
+            return 1;
+        }
+    }
+#endif
+
+    printf("%s host, best of %i runs\n", (ARIBEIRO_BINARY_BIG_ENDIAN) ? "big endian" : "little endian", Runs);
+    printf("  %u uint32: native %8.2f ms, little endian %8.2f ms\n", WordCount, nativeUInt32Ms, littleUInt32Ms);
+    printf("  %u float:  native %8.2f ms, little endian %8.2f ms\n", WordCount, nativeFloatMs, littleFloatMs);
+    printf("  %u vec3:   native %8.2f ms, little endian %8.2f ms\n", VertexCount, nativeVec3Ms, littleVec3Ms);
+    // keeps the sums (and the loops) in the big endian build
+    printf("  checksum: %u %u %g %g\n", nativeUInt32.sum, littleUInt32.sum, nativeFloat.sum, littleFloat.sum);
+
+    return 0;
+}
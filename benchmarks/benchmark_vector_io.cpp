@@ -0,0 +1,105 @@
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/aRibeiroData.h>
+
+#include "Benchmark.h"
+
+using namespace aRibeiro;
+
+// Write and read of a vec3 array in memory (uncompressed):
+//
+//   element: the loop of writeVec3/readVec3, one call (and one bounds check) per element
+//   bulk: the writeVectorVec3/readVectorVec3, one length check and one strided copy
+//
+// Both write the same bytes.
+
+const uint32_t VertexCount = 1000000;
+const int Runs = 10;
+
+struct WriteElement {
+    const aligned_vector<vec3> *input;
+    BinaryWriter writer;
+    void operator()() {
+        writer.writeToBuffer(false);
+        writer.writeUInt32((uint32_t)input->size());
+        for (size_t i = 0; i < input->size(); i++)
+            writer.writeVec3((*input)[i]);
+        writer.close();
+    }
+};
+
+struct WriteBulk {
+    const aligned_vector<vec3> *input;
+    BinaryWriter writer;
+    void operator()() {
+        writer.writeToBuffer(false);
+        writer.writeVectorVec3(*input);
+        writer.close();
+    }
+};
+
+struct ReadElement {
+    const std::vector<uint8_t> *data;
+    aligned_vector<vec3> output;
+    BinaryReader reader;
+    void operator()() {
+        reader.readFromBorrowedBuffer(&(*data)[0], data->size());
+        output.resize(reader.readUInt32());
+        for (size_t i = 0; i < output.size(); i++)
+            output[i] = reader.readVec3();
+        reader.close();
+    }
+};
+
+struct ReadBulk {
+    const std::vector<uint8_t> *data;
+    aligned_vector<vec3> output;
+    BinaryReader reader;
+    void operator()() {
+        reader.readFromBorrowedBuffer(&(*data)[0], data->size());
+        reader.readVectorVec3(&output);
+        reader.close();
+    }
+};
+
+int main() {
+    aligned_vector<vec3> input;
+    input.resize(VertexCount);
+    for (uint32_t i = 0; i < VertexCount; i++)
+        input[i] = vec3((float)i, (float)i * 0.5f, (float)i * 0.25f);
+
+    WriteElement writeElement;
+    writeElement.input = &input;
+    WriteBulk writeBulk;
+    writeBulk.input = &input;
+
+    double writeElementMs = benchmarkBest(writeElement, Runs);
+    double writeBulkMs = benchmarkBest(writeBulk, Runs);
+
+    if (writeElement.writer.buffer != writeBulk.writer.buffer) {
+        printf("error: the element and the bulk writes are different\n");
+        return 1;
+    }
+
+    ReadElement readElement;
+    readElement.data = &writeBulk.writer.buffer;
+    ReadBulk readBulk;
+    readBulk.data = &writeBulk.writer.buffer;
+
+    double readElementMs = benchmarkBest(readElement, Runs);
+    double readBulkMs = benchmarkBest(readBulk, Runs);
+
+    for (uint32_t i = 0; i < VertexCount; i++) {
+        if (!(readElement.output[i] == input[i]) || !(readBulk.output[i] == input[i])) {
+            printf("error: the read does not match the input at %u\n", i);
+            return 1;
+        }
+    }
+
+    printf("%u vec3, best of %i runs\n", VertexCount, Runs);
+    printf("  write element: %8.2f ms\n", writeElementMs);
+    printf("  write bulk:    %8.2f ms (%.1fx)\n", writeBulkMs, writeElementMs / writeBulkMs);
+    printf("  read element:  %8.2f ms\n", readElementMs);
+    printf("  read bulk:     %8.2f ms (%.1fx)\n", readBulkMs, readElementMs / readBulkMs);
+
+    return 0;
+}
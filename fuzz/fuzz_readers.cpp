@@ -0,0 +1,378 @@
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/aRibeiroData.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace aRibeiro;
+
+// Fuzz harness of the readers of untrusted data:
+//
+//   model::ModelContainer::read, Atlas::read and FontReader::readGlyphTable
+//
+// Each input is opened in the non-aborting mode of the BinaryReader in the 3 ways:
+// uncompressed copy, borrowed memory and compressed. Any corruption need to end as a
+// reader error: an abort or a crash is a bug.
+//
+// Standalone mode (default):
+//
+//   fuzz_readers                     mutates valid streams (10000 iterations)
+//   fuzz_readers -n 100000 -s 7      iterations and random seed
+//   fuzz_readers crash-input.bin     runs the input files
+//
+// It also checks that every truncation of the valid streams is reported as an error.
+//
+// libFuzzer mode: build with -DARIBEIRO_DATA_LIBFUZZER and -fsanitize=fuzzer.
+//
+
+enum FuzzTarget {
+    FuzzTarget_Model = 0,
+    FuzzTarget_Atlas,
+    FuzzTarget_GlyphTable,
+    FuzzTarget_Count
+};
+
+enum FuzzOpen {
+    FuzzOpen_Copy = 0,
+    FuzzOpen_Borrowed,
+    FuzzOpen_Compressed,
+    FuzzOpen_Count
+};
+
+static const char *FuzzTarget_Names[FuzzTarget_Count] = { "ModelContainer", "Atlas", "GlyphTable" };
+
+// returns true when the reader reports an error
+static bool fuzzRead(int target, int open, const uint8_t *data, size_t size) {
+    BinaryReader reader;
+    reader.setAbortOnError(false);
+
+    bool opened;
+    if (open == FuzzOpen_Copy)
+        opened = reader.readFromBuffer(data, size, false);
+    else if (open == FuzzOpen_Borrowed)
+        opened = reader.readFromBorrowedBuffer(data, size);
+    else
+        opened = reader.readFromBuffer(data, size, true);
+    if (!opened)
+        return true;
+
+    if (target == FuzzTarget_Model) {
+        model::ModelContainer container;
+        container.read(&reader);
+    } else if (target == FuzzTarget_Atlas) {
+        Atlas atlas(1, 1);
+        atlas.read(&reader);
+    } else {
+        FontReader fontReader;
+        fontReader.readGlyphTable(&reader);
+    }
+
+    bool error = reader.hasError();
+    reader.close();
+    return error;
+}
+
+static void fuzzInput(const uint8_t *data, size_t size) {
+    for (int target = 0; target < FuzzTarget_Count; target++) {
+        for (int open = 0; open < FuzzOpen_Count; open++)
+            fuzzRead(target, open, data, size);
+    }
+}
+
+#if defined(ARIBEIRO_DATA_LIBFUZZER)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    fuzzInput(data, size);
+    return 0;
+}
+
+#else
+
+//
+// valid streams used as the start point of the mutations
+//
+
+static model::ModelContainer *createModel() {
+    model::ModelContainer *container = new model::ModelContainer();
+
+    for (int g = 0; g < 2; g++) {
+        model::Geometry geometry;
+        geometry.name = "geometry";
+        geometry.format = model::CONTAINS_POS | model::CONTAINS_NORMAL | model::CONTAINS_UV0 | model::CONTAINS_COLOR0;
+        geometry.indiceCountPerFace = 3;
+        geometry.vertexCount = 24;
+        // the second geometry uses the quantized attributes
+        if (g == 1)
+            geometry.quantization = model::GeometryQuantize_All;
+        for (uint32_t i = 0; i < geometry.vertexCount; i++) {
+            geometry.pos.push_back(vec3((float)i, (float)(i % 5), (float)g));
+            geometry.normals.push_back(vec3(0, 1, 0));
+            geometry.uv[0].push_back(vec3((float)i / 24.0f, 0.5f, 0));
+            geometry.color[0].push_back(vec4(1, 0.5f, 0.25f, 1));
+        }
+        for (uint32_t i = 0; i + 2 < geometry.vertexCount; i++) {
+            geometry.indice.push_back(i);
+            geometry.indice.push_back(i + 1);
+            geometry.indice.push_back(i + 2);
+        }
+        model::Bone bone;
+        bone.name = "bone";
+        for (uint32_t i = 0; i < geometry.vertexCount; i += 2) {
+            model::VertexWeight vertexWeight;
+            vertexWeight.vertexID = i;
+            vertexWeight.weight = 1.0f;
+            bone.weights.push_back(vertexWeight);
+        }
+        geometry.bones.push_back(bone);
+        container->geometries.push_back(geometry);
+    }
+
+    model::Animation animation;
+    animation.name = "animation";
+    animation.durationTicks = 10;
+    animation.ticksPerSecond = 30;
+    model::NodeAnimation channel;
+    channel.nodeName = "bone";
+    for (int k = 0; k < 4; k++) {
+        model::Vec3Key vec3Key;
+        vec3Key.time = (float)k;
+        vec3Key.value = vec3((float)k, 0, 0);
+        channel.positionKeys.push_back(vec3Key);
+        channel.scalingKeys.push_back(vec3Key);
+        model::QuatKey quatKey;
+        quatKey.time = (float)k;
+        quatKey.value = quat(0, 0, 0, 1);
+        channel.rotationKeys.push_back(quatKey);
+    }
+    animation.channels.push_back(channel);
+    container->animations.push_back(animation);
+
+    model::Material material;
+    material.name = "material";
+    material.floatValue["shininess"] = 2.0f;
+    material.vec3Value["diffuse"] = vec3(1, 1, 1);
+    model::Texture texture;
+    texture.filename = "texture.png";
+    material.textures.push_back(texture);
+    container->materials.push_back(material);
+
+    model::Light light;
+    light.name = "light";
+    light.type = model::LightType_POINT;
+    container->lights.push_back(light);
+    model::Camera camera;
+    camera.name = "camera";
+    container->cameras.push_back(camera);
+
+    for (int n = 0; n < 3; n++) {
+        model::Node node;
+        node.name = "node";
+        if (n == 0) {
+            node.children.push_back(1);
+            node.children.push_back(2);
+        } else
+            node.geometries.push_back(n - 1);
+        container->nodes.push_back(node);
+    }
+
+    return container;
+}
+
+static void createSeeds(std::vector< std::vector<uint8_t> > seeds[FuzzTarget_Count]) {
+    model::ModelContainer *container = createModel();
+
+    Atlas atlas(1, 1);
+    AtlasElement *elements[8];
+    for (int i = 0; i < 8; i++)
+        elements[i] = atlas.addElement(std::string("element") + (char)('a' + i), 4 + i, 6 + i);
+    atlas.organizePositions(true);
+
+    // the face and the stroke of 4 characters
+    FontWriter fontWriter;
+    fontWriter.initFromAtlas(&atlas, 16.0f, 4.0f, 18.0f);
+    for (int i = 0; i < 4; i++)
+        fontWriter.setCharacter('a' + i, 8.0f, 1, 2, elements[i], 1, 2, elements[i + 4]);
+
+    for (int open = 0; open < FuzzOpen_Count; open++) {
+        for (int target = 0; target < FuzzTarget_Count; target++) {
+            BinaryWriter writer;
+            writer.writeToBuffer(open == FuzzOpen_Compressed);
+            if (target == FuzzTarget_Model)
+                container->write(&writer);
+            else if (target == FuzzTarget_Atlas)
+                atlas.write(&writer);
+            else
+                fontWriter.writeGlyphTable(&writer);
+            writer.close();
+            seeds[target].push_back(writer.buffer);
+        }
+    }
+
+    delete container;
+}
+
+// a geometry reused by a read of an older revision cannot keep the quantization of its previous read
+static bool checkGeometryReuse(model::ModelContainer *container) {
+    const model::Geometry &quantized = container->geometries[1];
+    const model::Geometry &plain = container->geometries[0];
+
+    std::vector<uint8_t> streams[2];
+    for (int i = 0; i < 2; i++) {
+        BinaryWriter writer;
+        writer.writeToBuffer(false);
+        writer.revision = (i == 0) ? model::ModelRevision_Current : model::ModelRevision_Indices;
+        if (i == 0)
+            quantized.write(&writer);
+        else
+            plain.write(&writer);
+        writer.close();
+        streams[i] = writer.buffer;
+    }
+
+    model::Geometry geometry;
+    geometry.keepQuantized = true;
+    for (int i = 0; i < 2; i++) {
+        BinaryReader reader;
+        reader.setAbortOnError(false);
+        reader.readFromBuffer(&streams[i][0], streams[i].size(), false);
+        reader.revision = (i == 0) ? model::ModelRevision_Current : model::ModelRevision_Indices;
+        geometry.read(&reader);
+        if (reader.hasError())
+            return false;
+    }
+    return geometry.quantization == model::GeometryQuantize_None &&
+        geometry.quantized.pos.size() == 0 &&
+        geometry.quantized.normals.size() == 0 &&
+        geometry.quantized.uv[0].size() == 0 &&
+        geometry.quantized.color[0].size() == 0 &&
+        geometry.pos.size() == plain.pos.size();
+}
+
+// xorshift32: the same sequence in all platforms
+static uint32_t fuzzRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void mutate(std::vector<uint8_t> *data, uint32_t *state) {
+    int count = 1 + (int)(fuzzRandom(state) % 8);
+    for (int i = 0; i < count && data->size() > 0; i++) {
+        size_t pos = fuzzRandom(state) % data->size();
+        switch (fuzzRandom(state) % 6) {
+            case 0:
+                (*data)[pos] ^= (uint8_t)(1 << (fuzzRandom(state) % 8));
+                break;
+            case 1:
+                (*data)[pos] = (uint8_t)fuzzRandom(state);
+                break;
+            case 2:
+                (*data)[pos] = (fuzzRandom(state) & 1) ? 0xff : 0x00;
+                break;
+            case 3: {
+                // a big count or size
+                uint32_t big = 0x7fffffff >> (fuzzRandom(state) % 24);
+                for (size_t j = 0; j < 4 && pos + j < data->size(); j++)
+                    (*data)[pos + j] = (uint8_t)(big >> (j * 8));
+                break;
+            }
+            case 4:
+                data->insert(data->begin() + pos, (uint8_t)fuzzRandom(state));
+                break;
+            case 5:
+                data->erase(data->begin() + pos);
+                break;
+        }
+    }
+    if (fuzzRandom(state) % 5 == 0 && data->size() > 0)
+        data->resize(fuzzRandom(state) % data->size());
+}
+
+static bool readFile(const char *filename, std::vector<uint8_t> *data) {
+    FILE *in = fopen(filename, "rb");
+    if (in == NULL)
+        return false;
+    fseek(in, 0, SEEK_END);
+    data->resize((size_t)ftell(in));
+    fseek(in, 0, SEEK_SET);
+    size_t readed = (data->size() > 0) ? fread(&(*data)[0], sizeof(uint8_t), data->size(), in) : 0;
+    fclose(in);
+    return readed == data->size();
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 10000;
+    uint32_t seed = 1;
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else {
+            std::vector<uint8_t> data;
+            if (!readFile(argv[i], &data)) {
+                printf("error: cannot read the file %s\n", argv[i]);
+                return 1;
+            }
+            fuzzInput((data.size() > 0) ? &data[0] : NULL, data.size());
+            files++;
+        }
+    }
+    if (files > 0) {
+        printf("%i files: no crash\n", files);
+        return 0;
+    }
+
+    std::vector< std::vector<uint8_t> > seeds[FuzzTarget_Count];
+    createSeeds(seeds);
+
+    model::ModelContainer *container = createModel();
+    bool reuseOk = checkGeometryReuse(container);
+    delete container;
+    if (!reuseOk) {
+        printf("error: a geometry read from an older revision keeps its previous quantization\n");
+        return 1;
+    }
+
+    // the valid streams read without error, and all the truncations are errors
+    for (int target = 0; target < FuzzTarget_Count; target++) {
+        for (int open = 0; open < FuzzOpen_Count; open++) {
+            const std::vector<uint8_t> &data = seeds[target][open];
+            if (fuzzRead(target, open, &data[0], data.size())) {
+                printf("error: the valid %s stream has a read error\n", FuzzTarget_Names[target]);
+                return 1;
+            }
+            for (size_t size = 0; size < data.size(); size++) {
+                if (!fuzzRead(target, open, &data[0], size)) {
+                    printf("error: the %s stream truncated to %u bytes has no read error\n", FuzzTarget_Names[target], (uint32_t)size);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // mutations of the valid streams
+    uint32_t state = (seed != 0) ? seed : 1;
+    int errors = 0;
+    for (int i = 0; i < iterations; i++) {
+        int target = (int)(fuzzRandom(&state) % FuzzTarget_Count);
+        int open = (int)(fuzzRandom(&state) % FuzzOpen_Count);
+        std::vector<uint8_t> data = seeds[target][open];
+        mutate(&data, &state);
+        if (fuzzRead(target, open, (data.size() > 0) ? &data[0] : NULL, data.size()))
+            errors++;
+        // the other readers over the same bytes
+        fuzzInput((data.size() > 0) ? &data[0] : NULL, data.size());
+    }
+
+    printf("%i iterations (seed %u): %i read errors, no crash\n", iterations, seed, errors);
+    return 0;
+}
+
+#endif
@@ -250,7 +250,8 @@ namespace aRibeiro {
     
     void Atlas::read(aRibeiro::BinaryReader *reader){
         clearElements();
-        elements.resize(reader->readUInt32());
+        // each element has at least the string size and the 4 rect coords
+        elements.resize(reader->validateCount(reader->readUInt32(), sizeof(uint16_t) * 5));
         for(size_t i=0;i<elements.size();i++){
             AtlasElement *element = new AtlasElement();
             element->read(reader);
@@ -27,7 +27,8 @@ namespace aRibeiro {
         bitmapSize.read(reader);
 
         uint16_t glyphCount = reader->readUInt16();
-        for (uint16_t i = 0; i < glyphCount; i++) {
+        // stop at the first error (when the reader does not abort on error)
+        for (uint16_t i = 0; i < glyphCount && !reader->hasError(); i++) {
             FontReaderGlyph * glyph = new FontReaderGlyph();
             glyph->read(reader);
             glyphs.push_back(glyph);
@@ -38,6 +39,8 @@ namespace aRibeiro {
         uint8_t *pngBuffer;
         uint32_t pngBufferSize;
         reader->readBuffer(&pngBuffer, &pngBufferSize);
+        if (reader->hasError() || pngBuffer == NULL)
+            return;
 
         int w, h, chann, pixel_depth;
         bitmap = aRibeiro::PNGHelper::readPNGFromMemory((char*)pngBuffer, pngBufferSize, &w, &h, &chann, &pixel_depth);
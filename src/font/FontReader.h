@@ -48,7 +48,6 @@ namespace aRibeiro {
     class FontReader {
         void clear();
 
-        void readGlyphTable(aRibeiro::BinaryReader *reader);
         void readBitmap(aRibeiro::BinaryReader *reader);
 
         //private copy constructores, to avoid copy...
@@ -116,6 +115,37 @@ namespace aRibeiro {
         /// \param png_grayscale_8bits PNG image filename to load
         ///
         void readFromFile(const std::string &glyph, const std::string &png_grayscale_8bits);
+
+        /// \brief Read the glyph table saved with the #FontWriter::writeGlyphTable.
+        ///
+        /// The glyphs are appended to the #glyphs list.
+        ///
+        /// To read untrusted data, disable the abort on error of the reader
+        /// and check #aRibeiro::BinaryReader::hasError after this call.
+        ///
+        /// Example:
+        ///
+        /// \code
+        /// #include <aRibeiroCore/aRibeiroCore.h>
+        /// #include <aRibeiroData/aRibeiroData.h>
+        /// using namespace aRibeiro;
+        ///
+        /// BinaryReader reader;
+        /// reader.setAbortOnError(false);
+        /// reader.readFromBuffer(data, size);
+        ///
+        /// FontReader fontReader;
+        /// fontReader.readGlyphTable(&reader);
+        ///
+        /// if (reader.hasError()) {
+        ///     ...
+        /// }
+        /// \endcode
+        ///
+        /// \author Alessandro Ribeiro
+        /// \param reader The #aRibeiro::BinaryReader instance
+        ///
+        void readGlyphTable(aRibeiro::BinaryReader *reader);
     };
 
 }
@@ -0,0 +1,169 @@
+#include "BinaryCodec.h"
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <zlib.h>
+#include <string.h> // memcmp
+
+namespace aRibeiro {
+
+    class BinaryCodecStore : public BinaryCodec {
+    public:
+        uint8_t id()const {
+            return BinaryCodec_STORE;
+        }
+
+        void compress(const uint8_t *data, size_t size, int, std::vector<uint8_t> *output)const {
+            output->assign(data, data + size);
+        }
+
+        bool uncompress(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize)const {
+            if (size != outputSize)
+                return false;
+            memcpy(output, data, size);
+            return true;
+        }
+
+        uint32_t maxRatio()const {
+            return 1;
+        }
+    };
+
+    class BinaryCodecZLIB : public BinaryCodec {
+    public:
+        uint8_t id()const {
+            return BinaryCodec_ZLIB;
+        }
+
+        void compress(const uint8_t *data, size_t size, int level, std::vector<uint8_t> *output)const {
+            if (level == BinaryCodecLevel_DEFAULT)
+                level = Z_DEFAULT_COMPRESSION;
+            else if (level < Z_BEST_SPEED)
+                level = Z_BEST_SPEED;
+            else if (level > Z_BEST_COMPRESSION)
+                level = Z_BEST_COMPRESSION;
+
+            uLongf compressedSize = compressBound((uLong)size);
+            output->resize(compressedSize);
+            int ret = compress2(&(*output)[0], &compressedSize, data, (uLong)size, level);
+            ARIBEIRO_ABORT(ret != Z_OK, "Error to compress the stream block.\n");
+            output->resize(compressedSize);
+        }
+
+        bool uncompress(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize)const {
+            if (outputSize == 0)
+                return true;
+            uLongf rawSize = (uLongf)outputSize;
+            if (::uncompress(output, &rawSize, data, (uLong)size) != Z_OK)
+                return false;
+            return rawSize == outputSize;
+        }
+
+        uint32_t maxRatio()const {
+            // deflate limit
+            return 1032;
+        }
+    };
+
+    //
+    // Byte run-length encoding:
+    //
+    //   control < 128: copy the next (control + 1) bytes
+    //   control >= 128: repeat the next byte (control - 126) times
+    //
+    class BinaryCodecRLE : public BinaryCodec {
+    public:
+        uint8_t id()const {
+            return BinaryCodec_RLE;
+        }
+
+        void compress(const uint8_t *data, size_t size, int, std::vector<uint8_t> *output)const {
+            output->clear();
+            // worst case: one control byte each 128 literals
+            output->reserve(size + size / 128 + 1);
+
+            size_t i = 0;
+            size_t literalStart = 0;
+            while (i < size) {
+                size_t run = 1;
+                while (i + run < size && run < 129 && data[i + run] == data[i])
+                    run++;
+
+                if (run >= 3) {
+                    // flush the pending literals
+                    while (literalStart < i) {
+                        size_t count = i - literalStart;
+                        if (count > 128)
+                            count = 128;
+                        output->push_back((uint8_t)(count - 1));
+                        output->insert(output->end(), data + literalStart, data + literalStart + count);
+                        literalStart += count;
+                    }
+                    output->push_back((uint8_t)(run + 126));
+                    output->push_back(data[i]);
+                    i += run;
+                    literalStart = i;
+                } else
+                    i += run;
+            }
+
+            while (literalStart < size) {
+                size_t count = size - literalStart;
+                if (count > 128)
+                    count = 128;
+                output->push_back((uint8_t)(count - 1));
+                output->insert(output->end(), data + literalStart, data + literalStart + count);
+                literalStart += count;
+            }
+        }
+
+        bool uncompress(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize)const {
+            size_t in = 0;
+            size_t out = 0;
+            while (in < size) {
+                uint8_t control = data[in++];
+                if (control < 128) {
+                    size_t count = (size_t)control + 1;
+                    if (in + count > size || out + count > outputSize)
+                        return false;
+                    memcpy(&output[out], &data[in], count);
+                    in += count;
+                    out += count;
+                } else {
+                    size_t count = (size_t)control - 126;
+                    if (in >= size || out + count > outputSize)
+                        return false;
+                    memset(&output[out], data[in], count);
+                    in++;
+                    out += count;
+                }
+            }
+            return out == outputSize;
+        }
+
+        uint32_t maxRatio()const {
+            // a run of 129 bytes in 2 bytes
+            return 65;
+        }
+    };
+
+    static BinaryCodecStore BinaryCodec_Store_Instance;
+    static BinaryCodecZLIB BinaryCodec_ZLIB_Instance;
+    static BinaryCodecRLE BinaryCodec_RLE_Instance;
+
+    static const BinaryCodec* BinaryCodec_UserCodecs[256] = { NULL };
+
+    const BinaryCodec* BinaryCodec::get(uint8_t id) {
+        switch (id) {
+        case BinaryCodec_STORE: return &BinaryCodec_Store_Instance;
+        case BinaryCodec_ZLIB: return &BinaryCodec_ZLIB_Instance;
+        case BinaryCodec_RLE: return &BinaryCodec_RLE_Instance;
+        }
+        return BinaryCodec_UserCodecs[id];
+    }
+
+    void BinaryCodec::registerCodec(const BinaryCodec *codec) {
+        ARIBEIRO_ABORT(codec->id() < BinaryCodec_USER, "The codec identifiers below 128 are reserved.\n");
+        BinaryCodec_UserCodecs[codec->id()] = codec;
+    }
+
+}
@@ -0,0 +1,113 @@
+#ifndef BinaryCodec__H
+#define BinaryCodec__H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace aRibeiro {
+
+/// \brief Codec identifiers stored in the binary stream header.
+///
+/// Values from 0 to 127 are reserved to the library. The user codecs can use the values from 128 to 255.
+///
+enum BinaryCodecID {
+    BinaryCodec_STORE = 0x0, ///< No compression, the fastest.
+    BinaryCodec_ZLIB = 0x1, ///< ZLIB deflate. The level selects speed (1) or ratio (9).
+    BinaryCodec_RLE = 0x2, ///< Byte run-length encoding. Fast, good for sparse tables.
+
+    BinaryCodec_USER = 0x80 ///< First identifier available to user codecs.
+};
+
+/// \brief Compression level presets.
+///
+/// The ZLIB codec uses the levels 1 to 9. The other codecs may ignore the level.
+///
+enum BinaryCodecLevel {
+    BinaryCodecLevel_DEFAULT = -1,
+    BinaryCodecLevel_FASTEST = 1,
+    BinaryCodecLevel_BEST = 9
+};
+
+/// \brief Compression codec interface used by the #aRibeiro::BinaryStream blocks.
+///
+/// Each codec has an unique identifier written in the stream header, so the
+/// #aRibeiro::BinaryReader can select the decoder automatically.
+///
+/// Example of a user codec:
+///
+/// \code
+/// #include <aRibeiroCore/aRibeiroCore.h>
+/// #include <aRibeiroData/aRibeiroData.h>
+/// using namespace aRibeiro;
+///
+/// class MyCodec : public BinaryCodec {
+/// public:
+///     uint8_t id()const { return BinaryCodec_USER + 0; }
+///     void compress(const uint8_t *data, size_t size, int level, std::vector<uint8_t> *output)const { ... }
+///     bool uncompress(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize)const { ... }
+/// };
+///
+/// static MyCodec myCodec;
+/// BinaryCodec::registerCodec(&myCodec);
+/// \endcode
+///
+/// \author Alessandro Ribeiro
+///
+class BinaryCodec {
+public:
+    virtual ~BinaryCodec() {}
+
+    /// \brief The identifier written in the stream header
+    virtual uint8_t id()const = 0;
+
+    /// \brief Compress one block
+    ///
+    /// \param data The uncompressed data
+    /// \param size The uncompressed size
+    /// \param level The compression level (see #BinaryCodecLevel)
+    /// \param[out] output The compressed data
+    ///
+    virtual void compress(const uint8_t *data, size_t size, int level, std::vector<uint8_t> *output)const = 0;
+
+    /// \brief Decompress one block to a pre-allocated output
+    ///
+    /// \param data The compressed data
+    /// \param size The compressed size
+    /// \param output The output pointer
+    /// \param outputSize The exact uncompressed size
+    /// \return false if the data is corrupted
+    ///
+    virtual bool uncompress(const uint8_t *data, size_t size, uint8_t *output, size_t outputSize)const = 0;
+
+    /// \brief The maximum ratio between the uncompressed and the compressed size of a block
+    ///
+    /// Used to reject corrupted block sizes before allocate the output.
+    ///
+    /// \return the maximum ratio or 0 if it is unknown (the default)
+    ///
+    virtual uint32_t maxRatio()const {
+        return 0;
+    }
+
+    /// \brief Find a codec by its identifier
+    ///
+    /// \param id The codec identifier
+    /// \return the codec or NULL if there is no codec with this identifier
+    ///
+    static const BinaryCodec* get(uint8_t id);
+
+    /// \brief Register a user codec
+    ///
+    /// Should be called before any read or write that uses the codec.
+    ///
+    /// \param codec The codec instance. It need to be valid while it is registered.
+    ///
+    static void registerCodec(const BinaryCodec *codec);
+};
+
+}
+
+#endif
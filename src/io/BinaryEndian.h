@@ -0,0 +1,177 @@
+#ifndef BinaryEndian__H
+#define BinaryEndian__H
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+    #include <stdlib.h> // _byteswap_ushort, _byteswap_ulong, _byteswap_uint64
+#endif
+
+// The binary streams are always little endian.
+//
+// ARIBEIRO_BINARY_BIG_ENDIAN selects, at compile time, between the native copy
+// (little endian hosts: x86, ARM, ...) and the byte swap (big endian hosts).
+// It can be defined in the build to override the detection.
+#ifndef ARIBEIRO_BINARY_BIG_ENDIAN
+    #if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        #define ARIBEIRO_BINARY_BIG_ENDIAN 1
+    #elif defined(__BIG_ENDIAN__) || defined(__ARMEB__) || defined(__AARCH64EB__) || defined(__MIPSEB__) || defined(__THUMBEB__)
+        #define ARIBEIRO_BINARY_BIG_ENDIAN 1
+    #else
+        #define ARIBEIRO_BINARY_BIG_ENDIAN 0
+    #endif
+#endif
+
+namespace aRibeiro {
+
+/// \brief Byte order conversion between the host and the little endian binary streams.
+///
+/// In little endian hosts all methods are a plain copy, resolved at compile time.
+///
+/// The load and store methods use memcpy, so they are safe with unaligned pointers.
+///
+/// \author Alessandro Ribeiro
+///
+class BinaryEndian {
+public:
+
+    static inline uint16_t swap16(uint16_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap16(v);
+#elif defined(_MSC_VER)
+        return _byteswap_ushort(v);
+#else
+        return (uint16_t)((v >> 8) | (v << 8));
+#endif
+    }
+
+    static inline uint32_t swap32(uint32_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap32(v);
+#elif defined(_MSC_VER)
+        return _byteswap_ulong(v);
+#else
+        return (v >> 24) | ((v >> 8) & 0x0000ff00) | ((v << 8) & 0x00ff0000) | (v << 24);
+#endif
+    }
+
+    static inline uint64_t swap64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap64(v);
+#elif defined(_MSC_VER)
+        return _byteswap_uint64(v);
+#else
+        return ((uint64_t)swap32((uint32_t)v) << 32) | (uint64_t)swap32((uint32_t)(v >> 32));
+#endif
+    }
+
+    // host <-> little endian (the same operation in both directions)
+
+    static inline uint16_t little16(uint16_t v) {
+#if ARIBEIRO_BINARY_BIG_ENDIAN
+        return swap16(v);
+#else
+        return v;
+#endif
+    }
+
+    static inline uint32_t little32(uint32_t v) {
+#if ARIBEIRO_BINARY_BIG_ENDIAN
+        return swap32(v);
+#else
+        return v;
+#endif
+    }
+
+    static inline uint64_t little64(uint64_t v) {
+#if ARIBEIRO_BINARY_BIG_ENDIAN
+        return swap64(v);
+#else
+        return v;
+#endif
+    }
+
+    // unaligned little endian load/store
+
+    static inline void store16(uint8_t *output, uint16_t v) {
+        v = little16(v);
+        memcpy(output, &v, sizeof(uint16_t));
+    }
+
+    static inline void store32(uint8_t *output, uint32_t v) {
+        v = little32(v);
+        memcpy(output, &v, sizeof(uint32_t));
+    }
+
+    static inline void store64(uint8_t *output, uint64_t v) {
+        v = little64(v);
+        memcpy(output, &v, sizeof(uint64_t));
+    }
+
+    static inline uint16_t load16(const uint8_t *input) {
+        uint16_t v;
+        memcpy(&v, input, sizeof(uint16_t));
+        return little16(v);
+    }
+
+    static inline uint32_t load32(const uint8_t *input) {
+        uint32_t v;
+        memcpy(&v, input, sizeof(uint32_t));
+        return little32(v);
+    }
+
+    static inline uint64_t load64(const uint8_t *input) {
+        uint64_t v;
+        memcpy(&v, input, sizeof(uint64_t));
+        return little64(v);
+    }
+
+    /// \brief Convert the words of strided elements in place
+    ///
+    /// It does nothing in little endian hosts.
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The first element
+    /// \param count The number of elements
+    /// \param elementSize The size of each element (multiple of the wordSize)
+    /// \param stride The distance in bytes between two elements
+    /// \param wordSize 2, 4 or 8
+    ///
+    static inline void littleArray(void *data, size_t count, size_t elementSize, size_t stride, size_t wordSize) {
+#if ARIBEIRO_BINARY_BIG_ENDIAN
+        uint8_t *element = (uint8_t*)data;
+        for (size_t i = 0; i < count; i++, element += stride) {
+            for (size_t j = 0; j < elementSize; j += wordSize) {
+                if (wordSize == 2) {
+                    uint16_t v;
+                    memcpy(&v, &element[j], sizeof(uint16_t));
+                    v = swap16(v);
+                    memcpy(&element[j], &v, sizeof(uint16_t));
+                } else if (wordSize == 4) {
+                    uint32_t v;
+                    memcpy(&v, &element[j], sizeof(uint32_t));
+                    v = swap32(v);
+                    memcpy(&element[j], &v, sizeof(uint32_t));
+                } else if (wordSize == 8) {
+                    uint64_t v;
+                    memcpy(&v, &element[j], sizeof(uint64_t));
+                    v = swap64(v);
+                    memcpy(&element[j], &v, sizeof(uint64_t));
+                }
+            }
+        }
+#else
+        (void)data;
+        (void)count;
+        (void)elementSize;
+        (void)stride;
+        (void)wordSize;
+#endif
+    }
+
+};
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "BinaryFileHeader.h"
+#include "BinaryEndian.h"
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <zlib.h>
+#include <string.h> // memcmp
+
+namespace aRibeiro {
+
+    static const uint8_t BinaryFileHeader_Magic[4] = { 'a', 'R', 'B', 'F' };
+
+    BinaryFileHeader::BinaryFileHeader() {
+        version = Version;
+        flags = 0;
+        codec = 0;
+        uncompressedSize = 0;
+        crc = 0;
+    }
+
+    bool BinaryFileHeader::isCompressed()const {
+        return (flags & Flag_Compressed) != 0;
+    }
+
+    void BinaryFileHeader::write(uint8_t *output)const {
+        memcpy(&output[0], BinaryFileHeader_Magic, 4);
+        output[4] = version;
+        output[5] = flags;
+        output[6] = codec;
+        output[7] = 0;
+        BinaryEndian::store64(&output[8], uncompressedSize);
+        BinaryEndian::store32(&output[16], crc);
+        memset(&output[20], 0, Size - 20);
+    }
+
+    bool BinaryFileHeader::read(const uint8_t *data, size_t size) {
+        if (size < Size || memcmp(data, BinaryFileHeader_Magic, 4) != 0)
+            return false;
+        // the reader checks the version
+        version = data[4];
+        flags = data[5];
+        codec = data[6];
+        uncompressedSize = BinaryEndian::load64(&data[8]);
+        crc = BinaryEndian::load32(&data[16]);
+        return true;
+    }
+
+    bool BinaryFileHeader::check(const uint8_t *data, size_t size)const {
+        if ((uint64_t)size != uncompressedSize)
+            return false;
+        return updateCRC(0, data, size) == crc;
+    }
+
+    uint32_t BinaryFileHeader::updateCRC(uint32_t crc, const uint8_t *data, size_t size) {
+        uLong result = (uLong)crc;
+        // the zlib crc32 length is an uInt
+        while (size > 0) {
+            uInt n = (size > 0x40000000) ? 0x40000000 : (uInt)size;
+            result = crc32(result, data, n);
+            data += n;
+            size -= n;
+        }
+        return (uint32_t)result;
+    }
+
+}
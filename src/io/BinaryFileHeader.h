@@ -0,0 +1,91 @@
+#ifndef BinaryFileHeader__H
+#define BinaryFileHeader__H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace aRibeiro {
+
+/// \brief Fixed header written at the start of the files of the #aRibeiro::BinaryWriter.
+///
+/// With the header, the #aRibeiro::BinaryReader knows if the file is compressed,
+/// the exact uncompressed size and can check the payload integrity before parse it.
+///
+/// Layout:
+///
+/// \code
+/// magic "aRBF" | uint8 version | uint8 flags | uint8 codec | uint8 reserved | uint64 uncompressedSize | uint32 crc32 | 12 bytes reserved
+/// payload (compressed block stream or raw data)
+/// \endcode
+///
+/// The CRC32 is computed from the uncompressed payload.
+///
+/// The header is padded to 32 bytes, so the payload of a memory mapped file keeps a 32 bytes alignment.
+///
+/// Files without the magic are the legacy files, and the reader uses the compressed flag from the caller.
+///
+/// \author Alessandro Ribeiro
+///
+class BinaryFileHeader {
+public:
+
+    static const uint8_t Version = 1;
+    static const size_t Size = 32;
+
+    enum Flags {
+        Flag_Compressed = 0x1
+    };
+
+    uint8_t version;
+    uint8_t flags;
+    uint8_t codec;
+    uint64_t uncompressedSize;
+    uint32_t crc;
+
+    BinaryFileHeader();
+
+    bool isCompressed()const;
+
+    /// \brief Write the header to a #Size bytes output
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param[out] output The output with at least #Size bytes
+    ///
+    void write(uint8_t *output)const;
+
+    /// \brief Read the header from the start of a file data
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The file data
+    /// \param size The file data size
+    /// \return false if the data does not start with the header (legacy file)
+    ///
+    bool read(const uint8_t *data, size_t size);
+
+    /// \brief Check the uncompressed payload against the size and CRC32 of the header
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The uncompressed payload
+    /// \param size The uncompressed payload size
+    /// \return true if the payload is intact
+    ///
+    bool check(const uint8_t *data, size_t size)const;
+
+    /// \brief Update a running CRC32 (starts with 0)
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param crc The current CRC32
+    /// \param data The data
+    /// \param size The data size
+    /// \return the updated CRC32
+    ///
+    static uint32_t updateCRC(uint32_t crc, const uint8_t *data, size_t size);
+
+};
+
+}
+
+#endif
@@ -1,33 +1,306 @@
 #include "BinaryReader.h"
+#include "BinaryStream.h"
+#include "BinaryCodec.h"
+#include "BinaryFileHeader.h"
+#include "BinaryEndian.h"
 
-#include <zlib-wrapper/zlib-wrapper.h>
+#include <zlib.h>
 #include <string.h> // memcmp
 
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
 namespace aRibeiro {
 
     bool BinaryReader::eof() {
-        return readPos >= buffer.size();
+        if (_streaming && readPos >= memorySize && !streamEnd)
+            streamFill(1);
+        return readPos >= memorySize;
     }
 
     BinaryReader::BinaryReader() {
+        readPos = 0;
+        _streaming = false;
+        compressed = true;
+        streamWindowSize = 0;
+        streamIn = NULL;
+        streamEnd = true;
+        streamBlocksRemaining = 0;
+        streamCodec = NULL;
+        streamBlock = 0;
+        streamFileSize = 0;
+        streamBlockRawLeft = 0;
+        streamOffset = 0;
+        streamHasHeader = false;
+        streamCRC = 0;
+        streamTotal = 0;
+        zstream = NULL;
+        memory = NULL;
+        memorySize = 0;
+        mappedMemory = NULL;
+        mappedSize = 0;
+        revision = 0;
+        abortOnError = true;
+        error = false;
+    }
+
+    void BinaryReader::setAbortOnError(bool abortOnError) {
+        this->abortOnError = abortOnError;
+    }
+
+    bool BinaryReader::hasError()const {
+        return error;
+    }
+
+    const std::string &BinaryReader::getError()const {
+        return errorMessage;
+    }
+
+    void BinaryReader::setError(const std::string &message) {
+        ARIBEIRO_ABORT(abortOnError, "%s\n", message.c_str());
+        if (!error) {
+            error = true;
+            errorMessage = message;
+        }
+        // sticky: all the next reads fail in the bounds check
+        streamEnd = true;
+        readPos = memorySize;
+    }
+
+    uint32_t BinaryReader::validateCount(uint32_t count, size_t minElementSize) {
+        if (count == 0 || minElementSize == 0)
+            return count;
+        uint64_t available = memorySize - readPos;
+        if (_streaming && !streamEnd)
+            available += streamPendingBound();
+        if ((uint64_t)count * minElementSize > available) {
+            setError("Error to read buffer. Array size greater than the actual buffer.");
+            return 0;
+        }
+        return count;
+    }
+
+    uint64_t BinaryReader::streamPendingBound() {
+        // the bytes not in the window yet
+        if (streamHasHeader)
+            return (streamHeader.uncompressedSize > streamTotal) ? streamHeader.uncompressedSize - streamTotal : 0;
+        uint64_t fileLeft = streamFileSize - (uint64_t)ftell(streamIn);
+        if (!compressed)
+            return fileLeft;
+        if (streamCodec != NULL)
+            return streamBlockRawLeft;
+        // deflate never expands more than 1032:1
+        return (fileLeft + zstream->avail_in) * 1032;
+    }
+
+    void BinaryReader::useBufferMemory() {
+        memory = (buffer.size() > 0) ? &buffer[0] : NULL;
+        memorySize = buffer.size();
+    }
+
+    // inflate of the legacy streams (without the uncompressed size): the output grows
+    // while the inflate runs, and a truncated or corrupted stream returns false
+    static bool BinaryReader_Inflate(const uint8_t* data, size_t size, std::vector<uint8_t> *output) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(z_stream));
+        if (inflateInit(&zs) != Z_OK)
+            return false;
+        zs.next_in = (Bytef*)data;
+        zs.avail_in = (uInt)size;
+
+        output->resize((size < 1024) ? 4096 : size * 4);
+        size_t have = 0;
+        int ret = Z_OK;
+        while (ret == Z_OK) {
+            if (have == output->size())
+                output->resize(output->size() * 2);
+            size_t room = output->size() - have;
+            zs.next_out = &(*output)[have];
+            zs.avail_out = (uInt)((room < 0x40000000) ? room : 0x40000000);
+            uInt avail = zs.avail_out;
+            ret = inflate(&zs, Z_NO_FLUSH);
+            have += avail - zs.avail_out;
+        }
+        inflateEnd(&zs);
+        output->resize(have);
+        return ret == Z_STREAM_END;
+    }
+
+    bool BinaryReader::uncompressToBuffer(const uint8_t* data, size_t size, const BinaryFileHeader *header) {
+        // the previous buffer is reused as output, so a reader opened again does not allocate
+        std::vector<uint8_t> &output = inflateBuffer;
+        if (BinaryStream::isBlockStream(data, size)) {
+            if (!BinaryStream::uncompressBlocks(data, size, &output, (header != NULL) ? header->uncompressedSize : (uint64_t)-1))
+                return false;
+        } else if (header != NULL) {
+            // deflate never expands more than 1032:1, do not trust bigger header sizes
+            if (header->uncompressedSize / 1032 > (uint64_t)size)
+                return false;
+            // the header has the exact size: inflate once, without grow the output
+            output.resize((size_t)header->uncompressedSize);
+            if (output.size() > 0) {
+                uLongf rawSize = (uLongf)output.size();
+                int ret = uncompress(&output[0], &rawSize, data, (uLong)size);
+                if (ret != Z_OK || rawSize != output.size())
+                    return false;
+            }
+        } else if (!BinaryReader_Inflate(data, size, &output))
+            return false;
+        // data may point to the buffer itself
+        buffer.swap(output);
+        return true;
     }
 
-    void BinaryReader::readFromBuffer(const uint8_t* data, size_t size, bool compressed) {
-        if (compressed){
-            zlibWrapper::ZLIB zlib;
-            zlib.uncompress(data, (uint32_t)size);
-            buffer = zlib.zlibOutput;
+    bool BinaryReader::openData(const uint8_t* data, size_t size, bool compressed, const char* name) {
+        BinaryFileHeader header;
+        bool hasHeader = header.read(data, size);
+        readPos = 0;
+        if (hasHeader) {
+            if (header.version > BinaryFileHeader::Version) {
+                setError(std::string("Unsupported binary file version: ") + name);
+                return false;
+            }
+            compressed = header.isCompressed();
+            data += BinaryFileHeader::Size;
+            size -= BinaryFileHeader::Size;
+        }
+
+        if (compressed) {
+            buffer.clear();
+            if (size > 0 && !uncompressToBuffer(data, size, (hasHeader) ? &header : NULL)) {
+                buffer.clear();
+                useBufferMemory();
+                setError(std::string("Corrupted compressed data: ") + name);
+                return compressed;
+            }
+            useBufferMemory();
         } else {
+            memory = data;
+            memorySize = size;
+        }
+
+        // fail before any read, instead of in the middle of the parse
+        if (hasHeader && !header.check(memory, memorySize))
+            setError(std::string("Corrupted binary file: ") + name);
+
+        return compressed;
+    }
+
+    bool BinaryReader::readFromBuffer(const uint8_t* data, size_t size, bool compressed) {
+        close();
+        BinaryFileHeader header;
+        if (header.read(data, size))
+            compressed = header.isCompressed();
+        if (!compressed) {
             buffer.resize(size);
-            memcpy(&buffer[0], data, size);
+            if (size > 0)
+                memcpy(&buffer[0], data, size);
+            data = (size > 0) ? &buffer[0] : NULL;
         }
-        readPos = 0;
+        openData(data, size, compressed, "memory buffer");
+        return !error;
     }
 
-    void BinaryReader::readFromFile(const char* filename, bool compressed) {
+    bool BinaryReader::readFromBorrowedBuffer(const uint8_t* data, size_t size) {
+        close();
+        buffer.clear();
+        // data with a header skips it (and inflates when the header says it is compressed)
+        openData(data, size, false, "borrowed buffer");
+        return !error;
+    }
+
+    bool BinaryReader::readFromFileMapped(const char* filename, bool compressed) {
+        close();
+        buffer.clear();
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            setError(std::string("Error to open file: ") + filename);
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        mappedSize = (size_t)fileSize.QuadPart;
+        if (mappedSize > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+            // copy-on-write view: writes through the readBuffer pointer never reach the file
+            if (mapping != NULL) {
+                mappedMemory = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+            if (mappedMemory == NULL) {
+                CloseHandle(file);
+                mappedSize = 0;
+                setError(std::string("Error to map file: ") + filename);
+                return false;
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1) {
+            setError(std::string("Error to open file: ") + filename);
+            return false;
+        }
+        struct stat fileStat;
+        fstat(fd, &fileStat);
+        mappedSize = (size_t)fileStat.st_size;
+        if (mappedSize > 0) {
+            // copy-on-write mapping: writes through the readBuffer pointer never reach the file
+            mappedMemory = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (mappedMemory == MAP_FAILED) {
+                ::close(fd);
+                mappedMemory = NULL;
+                mappedSize = 0;
+                setError(std::string("Error to map file: ") + filename);
+                return false;
+            }
+            madvise(mappedMemory, mappedSize, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+#endif
+
+        // a compressed file is inflated straight from the mapped pages, without the compressed copy
+        if (openData((const uint8_t*)mappedMemory, mappedSize, compressed, filename))
+            unmap();
+        return !error;
+    }
+
+    void BinaryReader::unmap() {
+        if (mappedMemory != NULL) {
+#if defined(_WIN32)
+            UnmapViewOfFile(mappedMemory);
+#else
+            munmap(mappedMemory, mappedSize);
+#endif
+        }
+        mappedMemory = NULL;
+        mappedSize = 0;
+    }
+
+    bool BinaryReader::readFromFile(const char* filename, bool compressed) {
+        close();
         buffer.resize(0);
         FILE* in = fopen(filename, "rb");
-        if (in) {
+        if (!in) {
+            // the legacy behavior is an empty reader, the error is only recorded
+            if (!abortOnError)
+                setError(std::string("Error to open file: ") + filename);
+            return false;
+        } else {
             /*
             while (!feof(in)) {
                 uint8_t c;
@@ -51,33 +324,323 @@ namespace aRibeiro {
 
         //printf("reading size: %u\n", buffer.size());
 
-        if (compressed){
-            zlibWrapper::ZLIB zlib;
-            zlib.uncompress(&buffer[0], (uint32_t)buffer.size());
-            buffer = zlib.zlibOutput;
-        }
+        openData((buffer.size() > 0) ? &buffer[0] : NULL, buffer.size(), compressed, filename);
+        return !error;
+    }
+    
+
+    bool BinaryReader::readFromFileStream(const char* filename, bool compressed, size_t windowSize) {
+        ARIBEIRO_ABORT(windowSize == 0, "Invalid stream window size.\n");
+
+        close();
 
+        this->compressed = compressed;
+        _streaming = true;
+        streamWindowSize = windowSize;
+        streamEnd = false;
+
+        buffer.clear();
+        buffer.reserve(streamWindowSize);
+        useBufferMemory();
         readPos = 0;
+
+        streamIn = fopen(filename, "rb");
+        if (streamIn == NULL) {
+            setError(std::string("Error to open file: ") + filename);
+            return false;
+        }
+
+        fseek(streamIn, 0, SEEK_END);
+        long fileSize = ftell(streamIn);
+        fseek(streamIn, 0, SEEK_SET);
+        streamFileSize = (uint64_t)fileSize;
+
+        uint8_t fileHeader[BinaryFileHeader::Size];
+        size_t readed = fread(fileHeader, sizeof(uint8_t), BinaryFileHeader::Size, streamIn);
+        long start = 0;
+        streamHasHeader = streamHeader.read(fileHeader, readed);
+        streamCRC = 0;
+        streamTotal = 0;
+        if (streamHasHeader) {
+            if (streamHeader.version > BinaryFileHeader::Version) {
+                setError(std::string("Unsupported binary file version: ") + filename);
+                return false;
+            }
+            this->compressed = compressed = streamHeader.isCompressed();
+            start = (long)BinaryFileHeader::Size;
+            // the header size is used to validate the counts, it need to be possible for this file
+            // (with the maximum ratio of the header codec: 1032:1 for deflate, no limit when it is unknown)
+            uint64_t payloadSize = (uint64_t)(fileSize - start);
+            const BinaryCodec *headerCodec = BinaryCodec::get(streamHeader.codec);
+            uint64_t maxRatio = (headerCodec != NULL) ? headerCodec->maxRatio() : 0;
+            if ((!compressed && streamHeader.uncompressedSize != payloadSize) ||
+                (compressed && maxRatio > 0 && streamHeader.uncompressedSize / maxRatio > payloadSize)) {
+                setError(std::string("Corrupted binary file: ") + filename);
+                return false;
+            }
+        }
+        fseek(streamIn, start, SEEK_SET);
+
+        if (!compressed)
+            return true;
+
+        uint8_t header[BinaryStream::HeaderSize];
+        readed = fread(header, sizeof(uint8_t), BinaryStream::HeaderSize, streamIn);
+        if (BinaryStream::isBlockStream(header, readed)) {
+            uint8_t codecID = BinaryStream::readCodec(header);
+            uint32_t blockCount = BinaryStream::readBlockCount(header);
+            // the block index need to fit in the file
+            if (!BinaryStream::isSupported(header) ||
+                (uint64_t)blockCount * BinaryStream::BlockEntrySize > (uint64_t)(fileSize - start) - BinaryStream::HeaderSize) {
+                setError(std::string("Corrupted or unsupported binary stream: ") + filename);
+                return false;
+            }
+            if (blockCount == 0)
+                streamEnd = true;
+
+            if (codecID != BinaryCodec_ZLIB) {
+                // the other codecs decode one whole block at a time
+                streamCodec = BinaryCodec::get(codecID);
+                streamBlockIndex.resize(blockCount * 2);
+                if (blockCount > 0) {
+                    readed = fread(&streamBlockIndex[0], BinaryStream::BlockEntrySize, blockCount, streamIn);
+                    if (readed != blockCount) {
+                        setError(std::string("Corrupted binary stream block index: ") + filename);
+                        return false;
+                    }
+                    BinaryEndian::littleArray(&streamBlockIndex[0], streamBlockIndex.size(), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t));
+                }
+                // validate the index before any block allocation: the blocks need to fit in the file
+                // and, with the file header, the blocks need to sum the size from the header
+                uint64_t maxRatio = streamCodec->maxRatio();
+                uint64_t compressedLeft = (uint64_t)(fileSize - ftell(streamIn));
+                streamBlockRawLeft = 0;
+                for (size_t i = 0; i < streamBlockIndex.size(); i += 2) {
+                    if (streamBlockIndex[i + 1] > compressedLeft ||
+                        (maxRatio > 0 && streamBlockIndex[i] > (uint64_t)streamBlockIndex[i + 1] * maxRatio)) {
+                        setError(std::string("Corrupted binary stream block index: ") + filename);
+                        return false;
+                    }
+                    compressedLeft -= streamBlockIndex[i + 1];
+                    streamBlockRawLeft += streamBlockIndex[i];
+                }
+                if (streamHasHeader) {
+                    if (streamBlockRawLeft != streamHeader.uncompressedSize) {
+                        setError(std::string("Corrupted binary stream block index: ") + filename);
+                        return false;
+                    }
+                }
+                streamBlock = 0;
+                return true;
+            }
+
+            // the ZLIB blocks are inflated one after the other,
+            // the block index is not needed to read them in sequence
+            streamBlocksRemaining = blockCount;
+            fseek(streamIn, start + (long)(BinaryStream::HeaderSize + BinaryStream::BlockEntrySize * blockCount), SEEK_SET);
+        } else {
+            streamBlocksRemaining = 1;
+            fseek(streamIn, start, SEEK_SET);
+        }
+
+        zstream = new z_stream_s();
+        memset(zstream, 0, sizeof(z_stream_s));
+        int ret = inflateInit(zstream);
+        ARIBEIRO_ABORT(ret != Z_OK, "Error to initialize the ZLIB inflate.\n");
+        zstreamInput.resize(streamWindowSize);
+        return true;
+    }
+
+    void BinaryReader::streamFill(size_t size) {
+        // discard the bytes already read
+        size_t remaining = buffer.size() - readPos;
+        streamOffset += readPos;
+        if (readPos > 0) {
+            if (remaining > 0)
+                memmove(&buffer[0], &buffer[readPos], remaining);
+            buffer.resize(remaining);
+            readPos = 0;
+        }
+        useBufferMemory();
+
+        size_t target = (size > streamWindowSize) ? size : streamWindowSize;
+        if (remaining >= target || streamEnd)
+            return;
+
+        buffer.resize(target);
+        size_t filled = remaining;
+
+        while (filled < target && !streamEnd) {
+            if (!compressed) {
+                size_t readed = fread(&buffer[filled], sizeof(uint8_t), target - filled, streamIn);
+                filled += readed;
+                if (readed == 0)
+                    streamEnd = true;
+                continue;
+            }
+
+            if (streamCodec != NULL) {
+                if (streamBlock * 2 >= streamBlockIndex.size()) {
+                    streamEnd = true;
+                    continue;
+                }
+                uint32_t rawSize = streamBlockIndex[streamBlock * 2];
+                uint32_t compressedSize = streamBlockIndex[streamBlock * 2 + 1];
+                streamBlock++;
+                streamBlockRawLeft -= rawSize;
+
+                if (filled + rawSize > buffer.size())
+                    buffer.resize(filled + rawSize);
+                zstreamInput.resize(compressedSize);
+                size_t readed = 0;
+                if (compressedSize > 0)
+                    readed = fread(&zstreamInput[0], sizeof(uint8_t), compressedSize, streamIn);
+                if (readed != compressedSize) {
+                    setError("Error to read the stream. Unexpected end of file.");
+                    break;
+                }
+                if (!streamCodec->uncompress((compressedSize > 0) ? &zstreamInput[0] : NULL, compressedSize, (rawSize > 0) ? &buffer[filled] : NULL, rawSize)) {
+                    setError("Error to decode the stream block.");
+                    break;
+                }
+                filled += rawSize;
+                continue;
+            }
+
+            if (zstream->avail_in == 0) {
+                size_t readed = fread(&zstreamInput[0], sizeof(uint8_t), zstreamInput.size(), streamIn);
+                zstream->next_in = &zstreamInput[0];
+                zstream->avail_in = (uInt)readed;
+                if (readed == 0) {
+                    setError("Error to inflate the stream. Unexpected end of file.");
+                    break;
+                }
+            }
+
+            zstream->next_out = &buffer[filled];
+            zstream->avail_out = (uInt)(target - filled);
+            int ret = inflate(zstream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END) {
+                setError("Error to inflate the stream.");
+                break;
+            }
+            filled = target - zstream->avail_out;
+            if (ret == Z_STREAM_END) {
+                streamBlocksRemaining--;
+                if (streamBlocksRemaining == 0)
+                    streamEnd = true;
+                else
+                    inflateReset(zstream);
+            }
+        }
+
+        buffer.resize(filled);
+        useBufferMemory();
+
+        if (streamHasHeader && !error) {
+            if (filled > remaining) {
+                streamCRC = BinaryFileHeader::updateCRC(streamCRC, &buffer[remaining], filled - remaining);
+                streamTotal += filled - remaining;
+            }
+            if (streamEnd) {
+                if (streamTotal != streamHeader.uncompressedSize || streamCRC != streamHeader.crc)
+                    setError("Corrupted binary file. The size or the CRC32 does not match the header.");
+                streamHasHeader = false;
+            }
+        }
+
+        // nothing is read after an error
+        if (error)
+            readPos = memorySize;
+    }
+
+    void BinaryReader::streamRelease() {
+        if (zstream != NULL) {
+            inflateEnd(zstream);
+            delete zstream;
+            zstream = NULL;
+        }
+        zstreamInput.clear();
+        streamCodec = NULL;
+        streamBlockIndex.clear();
+        streamBlock = 0;
+        streamHasHeader = false;
+        if (streamIn != NULL) {
+            fclose(streamIn);
+            streamIn = NULL;
+        }
+        _streaming = false;
+        streamEnd = true;
     }
-    
 
     BinaryReader::~BinaryReader() {
         close();
     }
 
     void BinaryReader::close() {
+        streamRelease();
+        unmap();
+        memory = NULL;
+        memorySize = 0;
+        readPos = 0;
+        streamOffset = 0;
+        error = false;
+        errorMessage.clear();
+        stringTable.clear();
     }
 
     void BinaryReader::read( void* data, int size ) {
 
-        ARIBEIRO_ABORT( (readPos + size) > this->buffer.size(), "Error to read buffer. Size greater than the actuan buffer is...");
+        if (_streaming && (readPos + size) > memorySize)
+            streamFill(size);
+
+        if ((readPos + size) > memorySize) {
+            setError("Error to read buffer. Size greater than the actual buffer.");
+            memset(data, 0, size);
+            return;
+        }
 
         if (eof()) {
             memset(data, 0 , size);
             return;
         }
-        memcpy(data, &buffer[readPos], size);
+        memcpy(data, &memory[readPos], size);
+        readPos += size;
+    }
+
+    bool BinaryReader::peek( void* data, int size ) {
+        if (_streaming && (readPos + size) > memorySize)
+            streamFill(size);
+        if ((readPos + size) > memorySize)
+            return false;
+        memcpy(data, &memory[readPos], size);
+        return true;
+    }
+
+    const uint8_t* BinaryReader::readPointer(size_t size) {
+        if (_streaming && (readPos + size) > memorySize)
+            streamFill(size);
+        if ((readPos + size) > memorySize) {
+            setError("Error to read buffer. Size greater than the actual buffer.");
+            return NULL;
+        }
+        const uint8_t *result = &memory[readPos];
         readPos += size;
+        return result;
+    }
+
+    void BinaryReader::readAlign(size_t alignment) {
+        size_t padding = (alignment - readedSize() % alignment) % alignment;
+        if (padding > 0)
+            readPointer(padding);
+    }
+
+    size_t BinaryReader::readedSize() const {
+        return (size_t)streamOffset + readPos;
+    }
+
+    bool BinaryReader::isStreaming() const {
+        return _streaming;
     }
 
     uint8_t BinaryReader::readUInt8() {
@@ -95,30 +658,35 @@ namespace aRibeiro {
     uint16_t BinaryReader::readUInt16() {
         uint16_t result;
         read( &result, sizeof(uint16_t) );
-        return result;
+        return BinaryEndian::little16(result);
     }
 
     int16_t BinaryReader::readInt16() {
-        int16_t result;
-        read( &result, sizeof(int16_t) );
-        return result;
+        return (int16_t)readUInt16();
     }
 
     uint32_t BinaryReader::readUInt32() {
         uint32_t result;
         read( &result, sizeof(uint32_t) );
-        return result;
+        return BinaryEndian::little32(result);
     }
 
     int32_t BinaryReader::readInt32() {
-        int32_t result;
-        read( &result, sizeof(int32_t) );
-        return result;
+        return (int32_t)readUInt32();
+    }
+
+    uint64_t BinaryReader::readUInt64() {
+        uint64_t result;
+        read( &result, sizeof(uint64_t) );
+        return BinaryEndian::little64(result);
     }
 
     float BinaryReader::readFloat() {
+        uint32_t bits;
+        read( &bits, sizeof(uint32_t) );
+        bits = BinaryEndian::little32(bits);
         float result;
-        read( &result, sizeof(float) );
+        memcpy(&result, &bits, sizeof(float));
         return result;
     }
 
@@ -182,60 +750,154 @@ namespace aRibeiro {
         //result.resize(size + 1, '\0');
         if (size > 0) {
             result.resize(size);
-            memcpy(&result[0], &buffer[readPos], size);
-            readPos += size;
+            read(&result[0], size);
         }
         return &result[0];
     }
 
 
-    void BinaryReader::readVectorFloat(std::vector<float> *v){
-        v->resize(readUInt32());
-        for (size_t i=0;i<v->size();i++){
-            (*v)[i] = readFloat();
+    const std::string &BinaryReader::readStringRef() {
+        uint32_t ref = readVarUInt32();
+        if (ref == 0) {
+            stringTable.push_back(readString());
+            return stringTable.back();
         }
+        if (ref > stringTable.size()) {
+            setError("Error to read string. Invalid string table index.");
+            return emptyString;
+        }
+        return stringTable[ref - 1];
     }
 
-    void BinaryReader::readVectorUInt16(std::vector<uint16_t> *v) {
-        v->resize(readUInt32());
-        for (size_t i = 0; i < v->size(); i++) {
-            (*v)[i] = readUInt16();
+    void BinaryReader::readStrided(void* data, size_t count, size_t elementSize, size_t stride) {
+        uint8_t *dst = (uint8_t*)data;
+
+        // in memory the whole array is validated once, before any copy
+        if (!_streaming && count > (memorySize - readPos) / elementSize)
+            setError("Error to read buffer. Size greater than the actual buffer.");
+
+        while (count > 0) {
+            if (_streaming && (readPos + elementSize) > memorySize)
+                streamFill(elementSize);
+
+            // copy all elements available in the current window in one pass
+            size_t available = (memorySize - readPos) / elementSize;
+            if (available == 0) {
+                setError("Error to read buffer. Size greater than the actual buffer.");
+                // the elements not read are zero
+                for (size_t i = 0; i < count; i++)
+                    memset(dst + i * stride, 0, elementSize);
+                return;
+            }
+            size_t n = (count < available) ? count : available;
+
+            const uint8_t *src = &memory[readPos];
+            if (elementSize == stride)
+                memcpy(dst, src, n * elementSize);
+            else {
+                for (size_t i = 0; i < n; i++)
+                    memcpy(dst + i * stride, src + i * elementSize, elementSize);
+            }
+
+            readPos += n * elementSize;
+            dst += n * stride;
+            count -= n;
         }
     }
 
+    void BinaryReader::readVectorFloat(std::vector<float> *v){
+        v->resize(validateCount(readUInt32(), sizeof(float)));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(float), sizeof(float), sizeof(float));
+    }
+
+    void BinaryReader::readVectorUInt16(std::vector<uint16_t> *v) {
+        v->resize(validateCount(readUInt32(), sizeof(uint16_t)));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t));
+    }
+
     void BinaryReader::readVectorUInt32(std::vector<uint32_t> *v){
-        v->resize(readUInt32());
-        for (size_t i=0;i<v->size();i++){
-            (*v)[i] = readUInt32();
+        v->resize(validateCount(readUInt32(), sizeof(uint32_t)));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    uint32_t BinaryReader::readVarUInt32() {
+        // a varint has at most 5 bytes
+        if (_streaming && (readPos + 5) > memorySize)
+            streamFill(5);
+
+        uint32_t result = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (readPos >= memorySize) {
+                setError("Error to read buffer. Size greater than the actual buffer.");
+                return 0;
+            }
+            uint8_t byte = memory[readPos++];
+            result |= (uint32_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return result;
         }
+        setError("Error to read varint. More than 5 bytes.");
+        return 0;
     }
 
-    void BinaryReader::readVectorVec2(aligned_vector<vec2> *v){
-        v->resize(readUInt32());
-        for (size_t i=0;i<v->size();i++){
-            (*v)[i] = readVec2();
+    int32_t BinaryReader::readVarInt32() {
+        uint32_t v = readVarUInt32();
+        return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
+
+    void BinaryReader::readWords(void* data, size_t count, size_t elementSize, size_t stride, size_t wordSize) {
+        readStrided(data, count, elementSize, stride);
+        // no-op in little endian hosts
+        BinaryEndian::littleArray(data, count, elementSize, stride, wordSize);
+    }
+
+    void BinaryReader::readVectorUInt32Delta(std::vector<uint32_t> *v) {
+        // each delta has at least 1 byte
+        v->resize(validateCount(readVarUInt32(), 1));
+        uint32_t previous = 0;
+        for (size_t i = 0; i < v->size(); i++) {
+            uint32_t zigzag = readVarUInt32();
+            previous += (uint32_t)((int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1));
+            (*v)[i] = previous;
         }
     }
 
+    void BinaryReader::readVectorVec2(aligned_vector<vec2> *v){
+        v->resize(validateCount(readUInt32(), sizeof(float) * 2));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(float) * 2, sizeof(vec2), sizeof(float));
+    }
+
     void BinaryReader::readVectorVec3(aligned_vector<vec3> *v){
-        v->resize(readUInt32());
-        for (size_t i=0;i<v->size();i++){
-            (*v)[i] = readVec3();
-        }
+        // with SSE2 the vec3 is padded to 16 bytes in memory
+        v->resize(validateCount(readUInt32(), sizeof(float) * 3));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(float) * 3, sizeof(vec3), sizeof(float));
+    }
+
+    void BinaryReader::readVectorVec3XY(aligned_vector<vec3> *v){
+        uint32_t size = validateCount(readUInt32(), sizeof(float) * 2);
+        // the z of the recycled elements is zero too
+        v->clear();
+        v->resize(size);
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(float) * 2, sizeof(vec3), sizeof(float));
     }
 
     void BinaryReader::readVectorVec4(aligned_vector<vec4> *v){
-        v->resize(readUInt32());
-        for (size_t i=0;i<v->size();i++){
-            (*v)[i] = readVec4();
-        }
+        v->resize(validateCount(readUInt32(), sizeof(float) * 4));
+        if (v->size() > 0)
+            readWords(&(*v)[0], v->size(), sizeof(float) * 4, sizeof(vec4), sizeof(float));
     }
 
 
     void BinaryReader::readStringMapFloat(std::map<std::string,float> *result){
         if (eof())
             return;
-        uint32_t size = readUInt32();
+        uint32_t size = validateCount(readUInt32(), sizeof(uint16_t) + sizeof(float));
         //std::map<std::string, T> result;
         (*result).clear();
         for (int i = 0; i < size; i++) {
@@ -248,7 +910,7 @@ namespace aRibeiro {
     void BinaryReader::readStringMapInt32(std::map<std::string,int32_t> *result){
         if (eof())
             return;
-        uint32_t size = readUInt32();
+        uint32_t size = validateCount(readUInt32(), sizeof(uint16_t) + sizeof(int32_t));
         //std::map<std::string, T> result;
         (*result).clear();
         for (int i = 0; i < size; i++) {
@@ -261,7 +923,7 @@ namespace aRibeiro {
     void BinaryReader::readStringMapVec2(aligned_map<std::string,vec2> *result){
         if (eof())
             return;
-        uint32_t size = readUInt32();
+        uint32_t size = validateCount(readUInt32(), sizeof(uint16_t) + sizeof(float) * 2);
         //std::map<std::string, T> result;
         (*result).clear();
         for (int i = 0; i < size; i++) {
@@ -274,7 +936,7 @@ namespace aRibeiro {
     void BinaryReader::readStringMapVec3(aligned_map<std::string,vec3> *result){
         if (eof())
             return;
-        uint32_t size = readUInt32();
+        uint32_t size = validateCount(readUInt32(), sizeof(uint16_t) + sizeof(float) * 3);
         //std::map<std::string, T> result;
         (*result).clear();
         for (int i = 0; i < size; i++) {
@@ -287,7 +949,7 @@ namespace aRibeiro {
     void BinaryReader::readStringMapVec4(aligned_map<std::string,vec4> *result){
         if (eof())
             return;
-        uint32_t size = readUInt32();
+        uint32_t size = validateCount(readUInt32(), sizeof(uint16_t) + sizeof(float) * 4);
         //std::map<std::string, T> result;
         (*result).clear();
         for (int i = 0; i < size; i++) {
@@ -298,13 +960,20 @@ namespace aRibeiro {
     }
 
     void BinaryReader::readBuffer(uint8_t **buffer, uint32_t *size) {
-        *size = readUInt32();
+        // validated before the stream window grows to the buffer size
+        *size = validateCount(readUInt32(), 1);
+        if (_streaming && (readPos + *size) > memorySize)
+            streamFill(*size);
+        if ((readPos + *size) > memorySize) {
+            setError("Error to load Buffer. Size greater than the actual buffer.");
+            *buffer = NULL;
+            *size = 0;
+            return;
+        }
         //read((*buffer), *size);
-        *buffer = &this->buffer[readPos];
+        *buffer = (uint8_t*)&memory[readPos];
         //memcpy(data, &buffer[readPos], size);
         readPos += *size;
-
-        ARIBEIRO_ABORT( readPos > this->buffer.size(), "Error to load Buffer. Size greater than the actuan buffer is..." );
     }
 
 }
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
 
 #include <aRibeiroCore/mat4.h>
 #include <aRibeiroCore/quat.h>
@@ -12,8 +13,14 @@
 #include <aRibeiroCore/vec3.h>
 #include <aRibeiroCore/vec4.h>
 
+#include "BinaryFileHeader.h"
+
+// forward declaration of the zlib stream state (zlib.h)
+struct z_stream_s;
+
 namespace aRibeiro {
 
+class BinaryCodec;
 
 /// \brief Buffered File or Memory Stream Reader.
 ///
@@ -21,7 +28,12 @@ namespace aRibeiro {
 ///
 /// It does work in conjunction with the #aRibeiro::BinaryWriter, e. g., it can read what whas written by that class.
 ///
-/// It uses the ZLIB to decompress the data and check the file integrity using the #MD5 class.
+/// It uses the ZLIB to decompress the data. When the data starts with a #aRibeiro::BinaryFileHeader,
+/// the compressed flag from the header is used and the data integrity is checked (size and CRC32) before any read.
+///
+/// By default, any corrupted data aborts the application. To read untrusted data,
+/// call #setAbortOnError with false: the first error is recorded, all the next reads
+/// return zeros and the caller checks #hasError after the parse.
 ///
 /// Example:
 ///
@@ -47,14 +59,72 @@ class BinaryReader {
     std::vector<uint8_t> buffer;
     size_t readPos;
 
+    // the inflate output, swapped with the buffer (keeps the capacity of the previous open)
+    std::vector<uint8_t> inflateBuffer;
+
+    // the memory the reads come from: the buffer, a mapped file or a borrowed memory
+    const uint8_t *memory;
+    size_t memorySize;
+
+    // memory mapped mode state
+    void *mappedMemory;
+    size_t mappedSize;
+
+    void useBufferMemory();
+    bool uncompressToBuffer(const uint8_t* data, size_t size, const BinaryFileHeader *header = NULL);
+    // Set the reader memory from the data (with or without a file header).
+    // The errors go to the setError. Returns true when the reads do not reference the
+    // data anymore, so the caller can release it: the data was inflated to the buffer,
+    // or the inflate failed and the reader memory is empty.
+    bool openData(const uint8_t* data, size_t size, bool compressed, const char* name);
+    void unmap();
+
+    // streaming mode state
+    bool _streaming;
+    bool compressed;
+    size_t streamWindowSize;
+    FILE *streamIn;
+    bool streamEnd;
+    uint32_t streamBlocksRemaining;
+    z_stream_s *zstream;
+    const BinaryCodec *streamCodec;
+    std::vector<uint32_t> streamBlockIndex;
+    size_t streamBlock;
+    std::vector<uint8_t> zstreamInput;
+    bool streamHasHeader;
+    BinaryFileHeader streamHeader;
+    uint32_t streamCRC;
+    uint64_t streamTotal;
+    uint64_t streamFileSize;
+    uint64_t streamBlockRawLeft;
+    uint64_t streamOffset; // stream position of the window start
+
+    void streamFill(size_t size);
+    uint64_t streamPendingBound();
+
+    void readWords(void* data, size_t count, size_t elementSize, size_t stride, size_t wordSize);
+    void streamRelease();
+
     bool eof();
+
+    // error mode state
+    bool abortOnError;
+    bool error;
+    std::string errorMessage;
+
+    // string table of the readStringRef, in the order the strings appear in the stream
+    // (the deque keeps the references valid while it grows)
+    std::deque<std::string> stringTable;
+    std::string emptyString;
 public:
 
+    uint32_t revision; ///< Layout revision of the data-model classes being read (0 = legacy layout).
+
     BinaryReader();
 
     /// \brief Create a reader from data allocating in the memory
     ///
-    /// The default read mode uses the ZLIB and MD5 to open the memory stream.
+    /// The default read mode uses the ZLIB to open the memory stream.
     ///
     /// Example:
     ///
@@ -75,13 +145,18 @@ public:
     /// \author Alessandro Ribeiro
     /// \param data Input data pointer
     /// \param size The amount of bytes in the input data
-    /// \param compressed If true, uses ZLIB and MD5 to read the stream
+    /// \param compressed If true, uses ZLIB to read the stream (legacy files without header)
     ///
-    void readFromBuffer(const uint8_t* data, size_t size, bool compressed = true);
+    /// \return false if the data is corrupted (only when the abort on error is disabled)
+    ///
+    bool readFromBuffer(const uint8_t* data, size_t size, bool compressed = true);
 
     /// \brief Create a reader from file
     ///
-    /// The default read mode uses the ZLIB and MD5 to open the file.
+    /// The default read mode uses the ZLIB to open the file.
+    ///
+    /// When the file starts with a #aRibeiro::BinaryFileHeader, the compressed parameter is ignored
+    /// and the file is checked against the header size and CRC32.
     ///
     /// Example:
     ///
@@ -98,14 +173,203 @@ public:
     ///
     /// \author Alessandro Ribeiro
     /// \param filename File to read
-    /// \param compressed If true, uses ZLIB and MD5 to read the stream
+    /// \param compressed If true, uses ZLIB to read the stream (legacy files without header)
+    ///
+    /// \return false if the file cannot be opened or it is corrupted (only when the abort on error is disabled)
+    ///
+    bool readFromFile(const char* filename, bool compressed = true);
+
+    /// \brief Create a reader from a memory mapped file
+    ///
+    /// When compressed is false, the reads come straight from the mapped pages,
+    /// without copy the file to the memory. The #readBuffer method returns pointers
+    /// to the mapped pages.
+    ///
+    /// When compressed is true, the ZLIB inflate reads straight from the mapped pages.
+    ///
+    /// The file is unmapped when the #close method is called.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFileMapped("input_file.bin", false);
+    ///
+    /// ...
+    ///
+    /// binaryReader.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param filename File to read
+    /// \param compressed If true, uses ZLIB to read the stream (legacy files without header)
+    ///
+    /// \return false if the file cannot be opened or it is corrupted (only when the abort on error is disabled)
+    ///
+    bool readFromFileMapped(const char* filename, bool compressed = false);
+
+    /// \brief Create a reader that wraps an uncompressed memory without copy it
+    ///
+    /// The memory is owned by the caller, and it need to be valid until the reader is closed.
+    ///
+    /// When the memory starts with a #aRibeiro::BinaryFileHeader (an uncompressed file written by
+    /// the #aRibeiro::BinaryWriter::writeToFile), the header is skipped and the data is checked
+    /// against the header size and CRC32. A header with the compressed flag inflates the data to the reader memory.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// uint8_t* buffer_data;
+    /// size_t buffer_size;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromBorrowedBuffer(buffer_data, buffer_size);
+    ///
+    /// ...
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data Input data pointer
+    /// \param size The amount of bytes in the input data
+    ///
+    /// \return false if the data is corrupted (only when the abort on error is disabled)
+    ///
+    bool readFromBorrowedBuffer(const uint8_t* data, size_t size);
+
+    /// \brief Create a reader that streams the data from the file while it is read
+    ///
+    /// The file content is inflated on demand (when compressed is true) as the read
+    /// methods move forward, keeping only a window of windowSize bytes in the memory.
+    ///
+    /// The window grows only when a single read needs more bytes than the window size
+    /// (for example: a #readBuffer bigger than the window).
+    ///
+    /// The pointer returned by #readBuffer is valid until the next read call.
+    ///
+    /// The size and CRC32 of the #aRibeiro::BinaryFileHeader are checked when the end of the stream is reached.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFileStream("input_file.bin");
+    ///
+    /// ...
+    ///
+    /// binaryReader.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param filename File to read
+    /// \param compressed If true, uses ZLIB to read the stream (legacy files without header)
+    /// \param windowSize The amount of bytes kept in the memory
+    ///
+    /// \return false if the file cannot be opened or its header is corrupted (only when the abort on error is disabled)
     ///
-    void readFromFile(const char* filename, bool compressed = true);
+    bool readFromFileStream(const char* filename, bool compressed = true, size_t windowSize = 64 * 1024);
     
     ~BinaryReader();
 
     void close();
 
+    /// \brief Select what happens when the data is corrupted or truncated
+    ///
+    /// When abortOnError is true (the default), the application is aborted with a message.
+    ///
+    /// When it is false, the first error is recorded and the reader stops: all the next reads
+    /// return zeros, empty strings and empty arrays, without allocate or read out of the buffer.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.setAbortOnError(false);
+    /// if ( binaryReader.readFromFile("untrusted_file.bin") ) {
+    ///     model::ModelContainer container;
+    ///     container.read(&binaryReader);
+    /// }
+    /// if ( binaryReader.hasError() )
+    ///     printf("%s\n", binaryReader.getError().c_str());
+    /// binaryReader.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param abortOnError false to record the error instead of abort
+    ///
+    void setAbortOnError(bool abortOnError);
+
+    /// \brief Check if an error was found since the last open
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return true if the data was corrupted or truncated
+    ///
+    bool hasError()const;
+
+    /// \brief The message of the first error found since the last open
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return the error message or an empty string
+    ///
+    const std::string &getError()const;
+
+    /// \brief Report an error found while parsing the data
+    ///
+    /// Used by the data-model classes to report invalid values (like an unsupported revision).
+    ///
+    /// It aborts when the abort on error is enabled, otherwise it stops the reader (see #setAbortOnError).
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param message the error message
+    ///
+    void setError(const std::string &message);
+
+    /// \brief Validate an element count read from the data before allocate the elements
+    ///
+    /// A corrupted count could allocate gigabytes before the read fails.
+    ///
+    /// Each element needs at least minElementSize bytes in the data. If the count does not fit in the
+    /// bytes left, the error is set and it returns 0.
+    ///
+    /// In the streaming mode without a #aRibeiro::BinaryFileHeader the exact size left is unknown,
+    /// and the count is validated against the maximum the rest of the file can inflate to.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// aligned_vector<vec3> data_readed;
+    /// data_readed.resize( binaryReader.validateCount( binaryReader.readUInt32(), sizeof(float) * 3 ) );
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param count The element count read from the data
+    /// \param minElementSize The minimum size in bytes of each element in the data
+    /// \return count, or 0 if the count is invalid
+    ///
+    uint32_t validateCount(uint32_t count, size_t minElementSize);
+
     /// \brief Make a copy of the current buffer in the data pointer, according the size parameter.
     ///
     /// You need to pre-allocate the size you want to read before call this method.
@@ -133,6 +397,98 @@ public:
     ///
     void read( void* data, int size );
 
+    /// \brief Copy the next bytes without move the read position.
+    ///
+    /// Used to detect an optional header before read it.
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The output buffer pointer to read data to
+    /// \param size the size to read in bytes
+    /// \return false if there are less than size bytes left
+    ///
+    bool peek( void* data, int size );
+
+    /// \brief Read the next bytes without copy.
+    ///
+    /// The pointer is inside the reader memory (the buffer, the mapped file or the borrowed memory),
+    /// and it is valid until the reader is closed or opened again.
+    ///
+    /// In the streaming mode (#readFromFileStream) the pointer is valid until the next read call.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFileMapped("input_file.bin");
+    ///
+    /// const uint8_t *data = binaryReader.readPointer( size );
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param size the size to read in bytes
+    /// \return the pointer to the bytes, or NULL if there are less than size bytes left
+    ///
+    const uint8_t* readPointer(size_t size);
+
+    /// \brief Skip the padding written by #aRibeiro::BinaryWriter::writeAlign
+    ///
+    /// Moves the read position to the next multiple of alignment, counting from the start of the data.
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param alignment the alignment in bytes
+    ///
+    void readAlign(size_t alignment);
+
+    /// \brief The amount of uncompressed bytes read since the reader was opened
+    ///
+    /// It is the counterpart of #aRibeiro::BinaryWriter::writtenSize.
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return the amount of bytes read
+    ///
+    size_t readedSize() const;
+
+    /// \brief Check if the reader is in the streaming mode (#readFromFileStream)
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return true if the memory is a window over the stream
+    ///
+    bool isStreaming() const;
+
+    /// \brief Read an array of elements with one bounds check and one copy pass.
+    ///
+    /// Each element has elementSize bytes in the stream, and it is copied to the
+    /// output with a distance of stride bytes between elements.
+    ///
+    /// It is used to read arrays where the memory layout is padded (like the vec3 with SSE2).
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// // read 3 floats from the stream to each 16 bytes vec3
+    /// aligned_vector<vec3> data_readed(count);
+    /// binaryReader.readStrided( &data_readed[0], count, sizeof(float) * 3, sizeof(vec3) );
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The output buffer pointer to read data to
+    /// \param count The number of elements to read
+    /// \param elementSize The size of each element in the stream
+    /// \param stride The distance in bytes between two elements in the output buffer
+    ///
+    void readStrided(void* data, size_t count, size_t elementSize, size_t stride);
+
     /// \brief Read 1 byte unsigned integer (uint8_t)
     ///
     /// Example:
@@ -253,6 +609,66 @@ public:
     ///
     int32_t readInt32();
 
+    /// \brief Read 8 bytes unsigned integer (uint64_t)
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// uint64_t data_readed = binaryReader.readUInt64();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return 8 bytes unsigned integer (uint64_t)
+    ///
+    uint64_t readUInt64();
+
+    /// \brief Read a LEB128 variable length unsigned integer (1 to 5 bytes)
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// uint32_t data_readed = binaryReader.readVarUInt32();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return 4 bytes unsigned integer (uint32_t)
+    ///
+    uint32_t readVarUInt32();
+
+    /// \brief Read a zigzag LEB128 variable length signed integer (1 to 5 bytes)
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// int32_t data_readed = binaryReader.readVarInt32();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return 4 bytes signed integer (int32_t)
+    ///
+    int32_t readVarInt32();
+
     /// \brief Read 4 bytes single precision float point number (float)
     ///
     /// Example:
@@ -395,6 +811,31 @@ public:
     ///
     std::string readString();
 
+    /// \brief Read a string written with #aRibeiro::BinaryWriter::writeStringRef
+    ///
+    /// Each string is allocated once, when it first appears in the stream.
+    /// The next reads of the same string return a reference to the table entry.
+    ///
+    /// The reference is valid until the reader is closed or opened again.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// const std::string &data_readed = binaryReader.readStringRef();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return 8bits character sequence string, ASCII (std::string)
+    ///
+    const std::string &readStringRef();
+
     /// \brief Read A STL vector of single precision float
     ///
     /// Example:
@@ -462,6 +903,28 @@ public:
     ///
     void readVectorUInt32(std::vector<uint32_t> *v);
 
+    /// \brief Read A STL vector of unsigned 4bytes integer written with #aRibeiro::BinaryWriter::writeVectorUInt32Delta
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// // readed vector
+    /// std::vector<uint32_t> data_readed;
+    /// binaryReader.readVectorUInt32Delta( &data_readed );
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param[out] v STL vector of unsigned 4bytes integer
+    ///
+    void readVectorUInt32Delta(std::vector<uint32_t> *v);
+
     /// \brief Read An aligned_vector of 8 bytes 2D vectors
     ///
     /// Example:
@@ -506,6 +969,30 @@ public:
     ///
     void readVectorVec3( aligned_vector<vec3> *v);
 
+    /// \brief Read An aligned_vector of 3D vectors written with only the x and y components
+    ///
+    /// The z of the readed vectors is zero. See BinaryWriter::writeVectorVec3XY.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryReader binaryReader;
+    ///
+    /// binaryReader.readFromFile("input_file.bin");
+    ///
+    /// // readed vector
+    /// aligned_vector<vec3> uv;
+    /// binaryReader.readVectorVec3XY( &uv );
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param[out] v aligned_vector of 3D vectors
+    ///
+    void readVectorVec3XY( aligned_vector<vec3> *v);
+
     /// \brief Read An aligned_vector of 16 bytes 3D vectors with Homogeneous coord
     ///
     /// Example:
@@ -642,6 +1129,8 @@ public:
     ///
     /// It does not make a copy of the buffer, it returns a pointer to the internal buffer that is in the memory.
     ///
+    /// In the streaming mode (#readFromFileStream) the pointer is valid until the next read call.
+    ///
     /// Example:
     ///
     /// \code
@@ -702,7 +1191,7 @@ public:
 ///
 template <typename T>
 void BinaryReader_ReadAlignedVector(BinaryReader* reader, aligned_vector<T> *v) {
-    v->resize(reader->readUInt32());
+    v->resize(reader->validateCount(reader->readUInt32(), 1));
     for (size_t i = 0; i < v->size(); i++) {
         (*v)[i].read(reader);
     }
@@ -749,7 +1238,7 @@ void BinaryReader_ReadAlignedVector(BinaryReader* reader, aligned_vector<T> *v)
 ///
 template <typename T>
 void BinaryReader_ReadAlignedStringMap(BinaryReader* reader, aligned_map<std::string, T> *result) {
-    uint32_t size = reader->readUInt32();
+    uint32_t size = reader->validateCount(reader->readUInt32(), 1);
     //std::map<std::string, T> result;
     (*result).clear();
     for (int i = 0; i < size; i++) {
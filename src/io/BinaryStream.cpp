@@ -0,0 +1,132 @@
+#include "BinaryStream.h"
+#include "BinaryCodec.h"
+#include "BinaryEndian.h"
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <string.h> // memcmp
+
+namespace aRibeiro {
+
+    static const uint8_t BinaryStream_Magic[4] = { 'a', 'R', 'B', 'S' };
+
+    bool BinaryStream::isBlockStream(const uint8_t *data, size_t size) {
+        // a ZLIB stream never starts with the magic:
+        // the low nibble of the first byte is always 8 (deflate)
+        return size >= HeaderSize && memcmp(data, BinaryStream_Magic, 4) == 0;
+    }
+
+    bool BinaryStream::isSupported(const uint8_t *data) {
+        return data[4] <= Version && BinaryCodec::get(data[5]) != NULL;
+    }
+
+    uint8_t BinaryStream::readCodec(const uint8_t *data) {
+        return data[5];
+    }
+
+    uint32_t BinaryStream::readBlockCount(const uint8_t *data) {
+        return BinaryEndian::load32(&data[8]);
+    }
+
+    void BinaryStream::compressBlocks(const uint8_t *data, size_t size, size_t blockSize, uint8_t codecID, int level, std::vector<uint8_t> *output) {
+        ARIBEIRO_ABORT(blockSize == 0 || blockSize > 0xffffffff, "Invalid block size.\n");
+
+        const BinaryCodec *codec = BinaryCodec::get(codecID);
+        ARIBEIRO_ABORT(codec == NULL, "Unsupported binary stream codec: %u\n", codecID);
+
+        uint32_t blockCount = (uint32_t)((size + blockSize - 1) / blockSize);
+        std::vector< std::vector<uint8_t> > blocks(blockCount);
+
+        int count = (int)blockCount;
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < count; i++) {
+            size_t start = (size_t)i * blockSize;
+            size_t rawSize = (size - start < blockSize) ? (size - start) : blockSize;
+            codec->compress(&data[start], rawSize, level, &blocks[i]);
+        }
+
+        size_t total = HeaderSize + BlockEntrySize * blockCount;
+        for (uint32_t i = 0; i < blockCount; i++)
+            total += blocks[i].size();
+
+        output->resize(total);
+        uint8_t *out = &(*output)[0];
+
+        memcpy(out, BinaryStream_Magic, 4);
+        out[4] = Version;
+        out[5] = codecID;
+        out[6] = 0;
+        out[7] = 0;
+        BinaryEndian::store32(&out[8], blockCount);
+
+        size_t indexPos = HeaderSize;
+        size_t blockPos = HeaderSize + BlockEntrySize * blockCount;
+        for (uint32_t i = 0; i < blockCount; i++) {
+            size_t start = (size_t)i * blockSize;
+            uint32_t rawSize = (uint32_t)((size - start < blockSize) ? (size - start) : blockSize);
+            uint32_t compressedSize = (uint32_t)blocks[i].size();
+            BinaryEndian::store32(&out[indexPos], rawSize);
+            BinaryEndian::store32(&out[indexPos + 4], compressedSize);
+            indexPos += BlockEntrySize;
+
+            if (compressedSize > 0)
+                memcpy(&out[blockPos], &blocks[i][0], compressedSize);
+            blockPos += compressedSize;
+            // release each block as soon as it is copied
+            std::vector<uint8_t>().swap(blocks[i]);
+        }
+    }
+
+    bool BinaryStream::uncompressBlocks(const uint8_t *data, size_t size, std::vector<uint8_t> *output, uint64_t maxSize) {
+        if (!isBlockStream(data, size) || !isSupported(data))
+            return false;
+        const BinaryCodec *codec = BinaryCodec::get(readCodec(data));
+        uint32_t blockCount = readBlockCount(data);
+        if ((size - HeaderSize) / BlockEntrySize < blockCount)
+            return false;
+
+        std::vector<size_t> rawOffset(blockCount);
+        std::vector<size_t> compressedOffset(blockCount);
+
+        uint64_t maxRatio = codec->maxRatio();
+        size_t rawTotal = 0;
+        size_t compressedTotal = HeaderSize + BlockEntrySize * blockCount;
+        for (uint32_t i = 0; i < blockCount; i++) {
+            uint32_t rawSize = BinaryEndian::load32(&data[HeaderSize + BlockEntrySize * i]);
+            uint32_t compressedSize = BinaryEndian::load32(&data[HeaderSize + BlockEntrySize * i + 4]);
+            if (maxRatio > 0 && rawSize > (uint64_t)compressedSize * maxRatio)
+                return false;
+            rawOffset[i] = rawTotal;
+            compressedOffset[i] = compressedTotal;
+            rawTotal += rawSize;
+            compressedTotal += compressedSize;
+        }
+
+        // validate the index before allocate the output
+        if (compressedTotal > size || (uint64_t)rawTotal > maxSize)
+            return false;
+
+        // the block index gives the exact uncompressed size: allocate once
+        output->resize(rawTotal);
+        bool error = false;
+
+        // each thread has its own error flag, they are or'ed at the end of the loop
+        int count = (int)blockCount;
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic) reduction(||:error)
+#endif
+        for (int i = 0; i < count; i++) {
+            size_t rawEnd = (i + 1 < count) ? rawOffset[i + 1] : rawTotal;
+            size_t compressedEnd = (i + 1 < count) ? compressedOffset[i + 1] : compressedTotal;
+            size_t rawSize = rawEnd - rawOffset[i];
+            if (rawSize == 0)
+                continue;
+            if (!codec->uncompress(&data[compressedOffset[i]], compressedEnd - compressedOffset[i], &(*output)[rawOffset[i]], rawSize))
+                error = true;
+        }
+
+        return !error;
+    }
+
+}
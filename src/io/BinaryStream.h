@@ -0,0 +1,104 @@
+#ifndef BinaryStream__H
+#define BinaryStream__H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace aRibeiro {
+
+/// \brief Block compressed stream format used by the #aRibeiro::BinaryWriter and #aRibeiro::BinaryReader.
+///
+/// The payload is split into independent blocks, so they can be compressed
+/// and decompressed in parallel (OpenMP). All blocks use the codec recorded
+/// in the header (see #aRibeiro::BinaryCodec).
+///
+/// Layout:
+///
+/// \code
+/// magic "aRBS" | uint8 version | uint8 codec | uint16 reserved | uint32 blockCount
+/// blockCount x { uint32 uncompressedSize | uint32 compressedSize }
+/// blockCount x compressed block
+/// \endcode
+///
+/// Streams without the magic are the legacy single ZLIB stream.
+///
+/// \author Alessandro Ribeiro
+///
+class BinaryStream {
+public:
+
+    static const uint8_t Version = 1;
+
+    static const size_t HeaderSize = 12;
+    static const size_t BlockEntrySize = 8;
+
+    static const size_t DefaultBlockSize = 1024 * 1024;
+
+    /// \brief Check if the data starts with the block stream header
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The stream data
+    /// \param size The stream size
+    /// \return true if it is a block stream
+    ///
+    static bool isBlockStream(const uint8_t *data, size_t size);
+
+    /// \brief Check if the version and the codec of a block stream header are supported
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The stream data, starting with the header
+    /// \return true if the stream can be decoded
+    ///
+    static bool isSupported(const uint8_t *data);
+
+    /// \brief Read the codec identifier from a block stream header
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The stream data, starting with the header
+    /// \return the codec identifier (see #aRibeiro::BinaryCodecID)
+    ///
+    static uint8_t readCodec(const uint8_t *data);
+
+    /// \brief Read the block count from a block stream header
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The stream data, starting with the header
+    /// \return the block count
+    ///
+    static uint32_t readBlockCount(const uint8_t *data);
+
+    /// \brief Compress the data as independent blocks in parallel
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The uncompressed data
+    /// \param size The uncompressed size
+    /// \param blockSize The uncompressed size of each block
+    /// \param codecID The codec used in all blocks (see #aRibeiro::BinaryCodecID)
+    /// \param level The compression level (see #aRibeiro::BinaryCodecLevel)
+    /// \param[out] output The block stream (header, block index and blocks)
+    ///
+    static void compressBlocks(const uint8_t *data, size_t size, size_t blockSize, uint8_t codecID, int level, std::vector<uint8_t> *output);
+
+    /// \brief Decompress all blocks of a block stream in parallel
+    ///
+    /// The output is allocated once, with the sum of the block sizes from the block index.
+    ///
+    /// The block index is validated before the allocation.
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The block stream
+    /// \param size The block stream size
+    /// \param[out] output The uncompressed data
+    /// \param maxSize The maximum uncompressed size accepted (the size from the file header, when it is known)
+    /// \return false if the stream is corrupted or not supported
+    ///
+    static bool uncompressBlocks(const uint8_t *data, size_t size, std::vector<uint8_t> *output, uint64_t maxSize = (uint64_t)-1);
+
+};
+
+}
+
+#endif
@@ -1,37 +1,367 @@
 #include "BinaryWriter.h"
+#include "BinaryStream.h"
+#include "BinaryCodec.h"
+#include "BinaryFileHeader.h"
+#include "BinaryEndian.h"
 
 #include <zlib-wrapper/zlib-wrapper.h>
+#include <zlib.h>
 #include <string.h> // memcmp
 
+#if defined(__linux__)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <stdlib.h>
+#endif
+
+// O_DIRECT needs the memory, the file offset and the size aligned to the device block
+#define BinaryWriter_DirectAlignment 4096
+
 namespace aRibeiro {
 
     BinaryWriter::BinaryWriter() {
         _writeToFile = false;
+        compress = true;
+        _streaming = false;
+        streamChunkSize = 0;
+        streamOut = NULL;
+        zstream = NULL;
+        _counting = false;
+        writtenCount = 0;
+        bufferUsed = 0;
+        blockSize = 0;
+        codecID = BinaryCodec_ZLIB;
+        codecLevel = BinaryCodecLevel_DEFAULT;
+        codecSelected = false;
+        streamCRC = 0;
+        directFD = -1;
+        directBuffer = NULL;
+        directCapacity = 0;
+        directFilled = 0;
+        directOffset = 0;
+        revision = 0;
+        strict = false;
+    }
+
+    void BinaryWriter::setBlockCompression(size_t blockSize) {
+        this->blockSize = blockSize;
+    }
+
+    void BinaryWriter::setCodec(uint8_t codecID, int level) {
+        ARIBEIRO_ABORT(BinaryCodec::get(codecID) == NULL, "Unsupported binary stream codec: %u\n", codecID);
+        this->codecID = codecID;
+        this->codecLevel = level;
+        codecSelected = true;
+
+        // the streaming mode is always ZLIB, but it follows the level
+        if (zstream != NULL && codecID == BinaryCodec_ZLIB) {
+            int ret = deflateParams(zstream, zlibLevel(), Z_DEFAULT_STRATEGY);
+            ARIBEIRO_ABORT(ret != Z_OK, "Error to set the ZLIB deflate level.\n");
+        }
+    }
+
+    int BinaryWriter::zlibLevel()const {
+        if (codecID != BinaryCodec_ZLIB || codecLevel == BinaryCodecLevel_DEFAULT)
+            return Z_DEFAULT_COMPRESSION;
+        if (codecLevel < Z_BEST_SPEED)
+            return Z_BEST_SPEED;
+        if (codecLevel > Z_BEST_COMPRESSION)
+            return Z_BEST_COMPRESSION;
+        return codecLevel;
     }
     
     void BinaryWriter::writeToFile(const char* filename, bool compress) {
+        if (!compress) {
+            // nothing to compress at the end: write the data as it arrives
+            streamOpen(filename, false, 64 * 1024, false);
+            return;
+        }
+        // finish a previous stream, and start from an empty buffer
+        if (_streaming)
+            close();
+        reset();
         name = filename;
         this->compress = compress;
         _writeToFile = true;
+        _counting = false;
         //out = fopen(filename, "wb");
     }
 
     void BinaryWriter::writeToBuffer(bool compress) {
+        // finish a previous stream, and start from an empty buffer
+        if (_streaming)
+            close();
+        reset();
         this->compress = compress;
         _writeToFile = false;
+        _counting = false;
         //out = fopen(filename, "wb");
     }
 
+    void BinaryWriter::writeToCounter() {
+        if (_streaming)
+            close();
+        reset();
+        compress = false;
+        _writeToFile = false;
+        _counting = true;
+    }
+
+    size_t BinaryWriter::writtenSize() const {
+        return writtenCount;
+    }
+
+    void BinaryWriter::writeAlign(size_t alignment) {
+        static const uint8_t zero[16] = { 0 };
+        size_t padding = (alignment - writtenCount % alignment) % alignment;
+        while (padding > 0) {
+            size_t size = (padding < sizeof(zero)) ? padding : sizeof(zero);
+            write((void*)zero, size);
+            padding -= size;
+        }
+    }
+
+    void BinaryWriter::reserve(size_t size) {
+        // the streaming mode never holds more than one chunk
+        if (_counting || _streaming)
+            return;
+        // the spare room is allocated (and zero filled) once here, the writes only copy to it
+        if (buffer.size() < size)
+            buffer.resize(size);
+    }
+
+    uint8_t *BinaryWriter::bufferAppend(size_t size) {
+        // the buffer.size() is the capacity, the bytes after the bufferUsed are the spare room
+        if (buffer.size() - bufferUsed < size) {
+            size_t capacity = buffer.size() * 2;
+            if (capacity < bufferUsed + size)
+                capacity = bufferUsed + size;
+            if (capacity < 256)
+                capacity = 256;
+            buffer.resize(capacity);
+        }
+        uint8_t *dst = &buffer[bufferUsed];
+        bufferUsed += size;
+        return dst;
+    }
+
+    void BinaryWriter::writeToFileStream(const char* filename, bool compress, size_t chunkSize) {
+        streamOpen(filename, compress, chunkSize, false);
+    }
+
+    void BinaryWriter::writeToFileDirect(const char* filename, size_t chunkSize) {
+        streamOpen(filename, false, chunkSize, true);
+    }
+
+    void BinaryWriter::streamOpen(const char* filename, bool compress, size_t chunkSize, bool direct) {
+        ARIBEIRO_ABORT(chunkSize == 0, "Invalid stream chunk size.\n");
+
+        if (_streaming)
+            close();
+        reset();
+
+        name = filename;
+        this->compress = compress;
+        _writeToFile = true;
+        _streaming = true;
+        _counting = false;
+        streamChunkSize = chunkSize;
+
+        buffer.resize(streamChunkSize);
+
+        streamCRC = 0;
+
+#if defined(__linux__) && defined(O_DIRECT)
+        if (direct) {
+            directFD = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+            // some file systems (tmpfs) reject O_DIRECT: use the buffered stream
+            if (directFD != -1) {
+                directCapacity = (chunkSize + BinaryWriter_DirectAlignment - 1) / BinaryWriter_DirectAlignment * BinaryWriter_DirectAlignment;
+                void *aligned = NULL;
+                int ret = posix_memalign(&aligned, BinaryWriter_DirectAlignment, directCapacity);
+                ARIBEIRO_ABORT(ret != 0, "Error to allocate the direct write buffer.\n");
+                directBuffer = (uint8_t*)aligned;
+                // the size and CRC32 are unknown until the close: the header is written again there
+                memset(directBuffer, 0, BinaryFileHeader::Size);
+                directFilled = BinaryFileHeader::Size;
+                directOffset = 0;
+                return;
+            }
+        }
+#endif
+
+        streamOut = fopen(filename, "wb");
+        ARIBEIRO_ABORT(streamOut == NULL, "Error to open file: %s\n", filename);
+
+        // the size and CRC32 are unknown until the close: the header is written again there
+        uint8_t header[BinaryFileHeader::Size];
+        memset(header, 0, BinaryFileHeader::Size);
+        fwrite(header, sizeof(uint8_t), BinaryFileHeader::Size, streamOut);
+
+        if (compress) {
+            zstream = new z_stream_s();
+            memset(zstream, 0, sizeof(z_stream_s));
+            int ret = deflateInit(zstream, zlibLevel());
+            ARIBEIRO_ABORT(ret != Z_OK, "Error to initialize the ZLIB deflate.\n");
+            zstreamOutput.resize(streamChunkSize);
+        }
+    }
+
+    void BinaryWriter::streamWrite(const uint8_t *data, size_t size, bool finish) {
+        if (size > 0)
+            streamCRC = BinaryFileHeader::updateCRC(streamCRC, data, size);
+
+        if (!compress) {
+            if (directFD != -1)
+                directWrite(data, size);
+            else if (size > 0)
+                fwrite(data, sizeof(uint8_t), size, streamOut);
+            return;
+        }
+
+        zstream->next_in = (Bytef*)data;
+        zstream->avail_in = (uInt)size;
+
+        int flush = (finish) ? Z_FINISH : Z_NO_FLUSH;
+        int ret;
+        do {
+            zstream->next_out = &zstreamOutput[0];
+            zstream->avail_out = (uInt)zstreamOutput.size();
+            ret = deflate(zstream, flush);
+            ARIBEIRO_ABORT(ret == Z_STREAM_ERROR, "Error to deflate the stream.\n");
+            size_t have = zstreamOutput.size() - zstream->avail_out;
+            if (have > 0)
+                fwrite(&zstreamOutput[0], sizeof(uint8_t), have, streamOut);
+        } while (zstream->avail_out == 0 || (finish && ret != Z_STREAM_END));
+    }
+
+    void BinaryWriter::directWrite(const uint8_t *data, size_t size) {
+#if defined(__linux__)
+        while (size > 0) {
+            size_t n = directCapacity - directFilled;
+            if (n > size)
+                n = size;
+            memcpy(&directBuffer[directFilled], data, n);
+            directFilled += n;
+            data += n;
+            size -= n;
+
+            if (directFilled == directCapacity) {
+                size_t written = 0;
+                while (written < directCapacity) {
+                    ssize_t ret = pwrite(directFD, &directBuffer[written], directCapacity - written, (off_t)(directOffset + written));
+                    if (ret == -1 && errno == EINTR)
+                        continue;
+                    ARIBEIRO_ABORT(ret <= 0, "Error to write file: %s\n", name.c_str());
+                    written += (size_t)ret;
+                }
+                directOffset += directCapacity;
+                directFilled = 0;
+            }
+        }
+#endif
+    }
+
+    void BinaryWriter::directClose(const uint8_t *header) {
+#if defined(__linux__) && defined(O_DIRECT)
+        // the tail and the header are not aligned: finish them through the page cache
+        int flags = fcntl(directFD, F_GETFL);
+        fcntl(directFD, F_SETFL, flags & ~O_DIRECT);
+
+        bool ok = true;
+        if (directFilled > 0)
+            ok = pwrite(directFD, directBuffer, directFilled, (off_t)directOffset) == (ssize_t)directFilled;
+        ok = ok && pwrite(directFD, header, BinaryFileHeader::Size, 0) == (ssize_t)BinaryFileHeader::Size;
+        ::close(directFD);
+        ARIBEIRO_ABORT(!ok, "Error to write file: %s\n", name.c_str());
+
+        free(directBuffer);
+#endif
+        directFD = -1;
+        directBuffer = NULL;
+        directCapacity = 0;
+        directFilled = 0;
+        directOffset = 0;
+    }
+
+    void BinaryWriter::streamFlush(bool finish) {
+        if (bufferUsed > 0 || finish)
+            streamWrite((bufferUsed > 0) ? &buffer[0] : NULL, bufferUsed, finish);
+        bufferUsed = 0;
+    }
+
     BinaryWriter::~BinaryWriter() {
         //close();
+        if (_streaming)
+            close();
     }
 
     void BinaryWriter::reset() {
         buffer.clear();
+        bufferUsed = 0;
+        writtenCount = 0;
+        stringTable.clear();
     }
 
     void BinaryWriter::close() {
-        if (compress) {
+        if (_counting)
+            return;
+
+        if (_streaming) {
+            streamFlush(true);
+            if (zstream != NULL) {
+                deflateEnd(zstream);
+                delete zstream;
+                zstream = NULL;
+            }
+            zstreamOutput.clear();
+
+            BinaryFileHeader fileHeader;
+            fileHeader.flags = (compress) ? (uint8_t)BinaryFileHeader::Flag_Compressed : (uint8_t)0;
+            fileHeader.codec = (compress) ? (uint8_t)BinaryCodec_ZLIB : (uint8_t)BinaryCodec_STORE;
+            fileHeader.uncompressedSize = writtenCount;
+            fileHeader.crc = streamCRC;
+
+            uint8_t header[BinaryFileHeader::Size];
+            fileHeader.write(header);
+
+            if (directFD != -1)
+                directClose(header);
+            if (streamOut != NULL) {
+                fseek(streamOut, 0, SEEK_SET);
+                fwrite(header, sizeof(uint8_t), BinaryFileHeader::Size, streamOut);
+
+                fclose(streamOut);
+                streamOut = NULL;
+            }
+            _streaming = false;
+            reset();
+            return;
+        }
+
+        // the buffer keeps only the written bytes
+        buffer.resize(bufferUsed);
+
+        BinaryFileHeader fileHeader;
+        if (_writeToFile) {
+            fileHeader.flags = (compress) ? (uint8_t)BinaryFileHeader::Flag_Compressed : (uint8_t)0;
+            fileHeader.codec = (compress) ? (uint8_t)codecID : (uint8_t)BinaryCodec_STORE;
+            fileHeader.uncompressedSize = buffer.size();
+            fileHeader.crc = BinaryFileHeader::updateCRC(0, (buffer.size() > 0) ? &buffer[0] : NULL, buffer.size());
+        }
+
+        if (compress && (blockSize > 0 || codecSelected || _writeToFile)) {
+            // the files and a selected codec always use the block stream,
+            // the block index gives the exact uncompressed size to the reader
+            size_t streamBlockSize = blockSize;
+            if (streamBlockSize == 0)
+                streamBlockSize = (buffer.size() > 0 && buffer.size() < 0xffffffff) ? buffer.size() : BinaryStream::DefaultBlockSize;
+
+            std::vector<uint8_t> blockStream;
+            BinaryStream::compressBlocks((buffer.size() > 0) ? &buffer[0] : NULL, buffer.size(), streamBlockSize, codecID, codecLevel, &blockStream);
+            buffer.swap(blockStream);
+        } else if (compress) {
             zlibWrapper::ZLIB zlib;
             zlib.compress(&buffer[0],(uint32_t)buffer.size());
             buffer = zlib.zlibOutput;
@@ -41,19 +371,32 @@ namespace aRibeiro {
             FILE *out = fopen(name.c_str(), "wb");
             if (out != NULL) {
                 //printf("writing size: %u\n", buffer.size());
+                uint8_t header[BinaryFileHeader::Size];
+                fileHeader.write(header);
+                fwrite(header, sizeof(uint8_t), BinaryFileHeader::Size, out);
                 if (buffer.size() > 0)
                     fwrite(&buffer[0], sizeof(uint8_t), buffer.size(), out);
                 fclose(out);
             }
             reset();
         }
-
+        bufferUsed = buffer.size();
     }
 
     void BinaryWriter::write(void *data, size_t size) {
-        size_t startWrite = buffer.size();
-        buffer.resize(startWrite + size);
-        memcpy(&buffer[startWrite], data, size);
+        writtenCount += size;
+        if (_counting || size == 0)
+            return;
+        if (_streaming && size >= streamChunkSize) {
+            // big blocks go straight to the stream, without copy
+            streamFlush(false);
+            streamWrite((const uint8_t*)data, size, false);
+            return;
+        }
+        // copy to the spare room, the growth is amortized (or none at all after a reserve call)
+        memcpy(bufferAppend(size), data, size);
+        if (_streaming && bufferUsed >= streamChunkSize)
+            streamFlush(false);
     }
 
     void BinaryWriter::writeUInt8(uint8_t v) {
@@ -65,23 +408,56 @@ namespace aRibeiro {
     }
 
     void BinaryWriter::writeUInt16(uint16_t v) {
+        v = BinaryEndian::little16(v);
         write(&v,sizeof(uint16_t));
     }
 
     void BinaryWriter::writeInt16(int16_t v) {
-        write(&v,sizeof(int16_t));
+        writeUInt16((uint16_t)v);
     }
 
     void BinaryWriter::writeUInt32(uint32_t v) {
+        v = BinaryEndian::little32(v);
         write(&v,sizeof(uint32_t));
     }
 
     void BinaryWriter::writeInt32(int32_t v) {
-        write(&v,sizeof(int32_t));
+        writeUInt32((uint32_t)v);
+    }
+
+    void BinaryWriter::writeUInt64(uint64_t v) {
+        v = BinaryEndian::little64(v);
+        write(&v,sizeof(uint64_t));
+    }
+
+    static inline size_t BinaryWriter_EncodeVarUInt32(uint32_t v, uint8_t *output) {
+        size_t count = 0;
+        while (v >= 0x80) {
+            output[count++] = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        output[count++] = (uint8_t)v;
+        return count;
+    }
+
+    static inline uint32_t BinaryWriter_ZigZag(int32_t v) {
+        return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    }
+
+    void BinaryWriter::writeVarUInt32(uint32_t v) {
+        uint8_t encoded[5];
+        write(encoded, BinaryWriter_EncodeVarUInt32(v, encoded));
+    }
+
+    void BinaryWriter::writeVarInt32(int32_t v) {
+        writeVarUInt32(BinaryWriter_ZigZag(v));
     }
 
     void BinaryWriter::writeFloat(float v) {
-        write(&v,sizeof(float));
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(float));
+        bits = BinaryEndian::little32(bits);
+        write(&bits, sizeof(uint32_t));
     }
 
     void BinaryWriter::writeQuat(const quat &v) {
@@ -118,54 +494,138 @@ namespace aRibeiro {
 
     void BinaryWriter::writeString(const std::string &s) {
         writeUInt16((uint16_t)s.size());
-        if (s.size() > 0) {
-            size_t startWrite = buffer.size();
-            buffer.resize(startWrite + s.size());
-            memcpy(&buffer[startWrite], s.c_str(), s.size());
+        if (s.size() > 0)
+            write((void*)s.c_str(), s.size());
+    }
+
+    void BinaryWriter::writeStringRef(const std::string &s) {
+        // 0: a new string follows, n: the string n - 1 from the table
+        std::map<std::string, uint32_t>::iterator it = stringTable.find(s);
+        if (it != stringTable.end()) {
+            writeVarUInt32(it->second + 1);
+            return;
         }
+        uint32_t index = (uint32_t)stringTable.size();
+        stringTable[s] = index;
+        writeVarUInt32(0);
+        writeString(s);
     }
 
 
+    void BinaryWriter::writeStrided(const void *data, size_t count, size_t elementSize, size_t stride) {
+        const uint8_t *src = (const uint8_t*)data;
+        if (elementSize == stride) {
+            write((void*)src, count * elementSize);
+            return;
+        }
+        writtenCount += count * elementSize;
+        if (_counting)
+            return;
+        while (count > 0) {
+            size_t n = count;
+            if (_streaming) {
+                // do not let the strided copy grow the buffer past the chunk size
+                size_t room = (streamChunkSize > bufferUsed) ? (streamChunkSize - bufferUsed) / elementSize : 0;
+                if (room == 0)
+                    room = 1;
+                if (n > room)
+                    n = room;
+            }
+
+            uint8_t *dst = bufferAppend(n * elementSize);
+            for (size_t i = 0; i < n; i++)
+                memcpy(dst + i * elementSize, src + i * stride, elementSize);
+
+            src += n * stride;
+            count -= n;
+
+            if (_streaming && bufferUsed >= streamChunkSize)
+                streamFlush(false);
+        }
+    }
+
+    void BinaryWriter::writeWords(const void *data, size_t count, size_t elementSize, size_t stride, size_t wordSize) {
+#if ARIBEIRO_BINARY_BIG_ENDIAN
+        // convert a small batch of elements at a time to little endian
+        uint8_t converted[4096];
+        size_t batch = sizeof(converted) / elementSize;
+        const uint8_t *src = (const uint8_t*)data;
+        while (count > 0) {
+            size_t n = (count < batch) ? count : batch;
+            for (size_t i = 0; i < n; i++)
+                memcpy(&converted[i * elementSize], src + i * stride, elementSize);
+            BinaryEndian::littleArray(converted, n, elementSize, elementSize, wordSize);
+            write(converted, n * elementSize);
+            src += n * stride;
+            count -= n;
+        }
+#else
+        // the memory is already little endian
+        (void)wordSize;
+        writeStrided(data, count, elementSize, stride);
+#endif
+    }
+
     void BinaryWriter::writeVectorFloat(const std::vector<float> &v){
         writeUInt32((uint32_t)v.size());
-        for (size_t i=0;i<v.size();i++){
-            writeFloat(v[i]);
-        }
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(float), sizeof(float), sizeof(float));
     }
 
     void BinaryWriter::writeVectorUInt16(const std::vector<uint16_t> &v) {
         writeUInt32((uint32_t)v.size());
-        for (size_t i = 0; i < v.size(); i++) {
-            writeUInt16(v[i]);
-        }
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t));
     }
 
     void BinaryWriter::writeVectorUInt32(const std::vector<uint32_t> &v){
         writeUInt32((uint32_t)v.size());
-        for (size_t i=0;i<v.size();i++){
-            writeUInt32(v[i]);
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    void BinaryWriter::writeVectorUInt32Delta(const std::vector<uint32_t> &v) {
+        writeVarUInt32((uint32_t)v.size());
+
+        // encode in small batches, so each batch is a single write call
+        uint8_t encoded[5 * 256];
+        size_t encodedSize = 0;
+        uint32_t previous = 0;
+        for (size_t i = 0; i < v.size(); i++) {
+            encodedSize += BinaryWriter_EncodeVarUInt32(BinaryWriter_ZigZag((int32_t)(v[i] - previous)), &encoded[encodedSize]);
+            previous = v[i];
+            if (encodedSize > sizeof(encoded) - 5) {
+                write(encoded, encodedSize);
+                encodedSize = 0;
+            }
         }
+        if (encodedSize > 0)
+            write(encoded, encodedSize);
     }
 
     void BinaryWriter::writeVectorVec2(const aligned_vector<vec2> &v){
         writeUInt32((uint32_t)v.size());
-        for (size_t i=0;i<v.size();i++){
-            writeVec2(v[i]);
-        }
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(float) * 2, sizeof(vec2), sizeof(float));
     }
 
     void BinaryWriter::writeVectorVec3(const aligned_vector<vec3> &v){
+        // with SSE2 the vec3 is padded to 16 bytes in memory
         writeUInt32((uint32_t)v.size());
-        for (size_t i=0;i<v.size();i++){
-            writeVec3(v[i]);
-        }
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(float) * 3, sizeof(vec3), sizeof(float));
+    }
+
+    void BinaryWriter::writeVectorVec3XY(const aligned_vector<vec3> &v){
+        writeUInt32((uint32_t)v.size());
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(float) * 2, sizeof(vec3), sizeof(float));
     }
 
     void BinaryWriter::writeVectorVec4(const aligned_vector<vec4> &v){
         writeUInt32((uint32_t)v.size());
-        for (size_t i=0;i<v.size();i++){
-            writeVec4(v[i]);
-        }
+        if (v.size() > 0)
+            writeWords(&v[0], v.size(), sizeof(float) * 4, sizeof(vec4), sizeof(float));
     }
 
 
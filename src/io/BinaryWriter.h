@@ -12,6 +12,9 @@
 #include <aRibeiroCore/vec3.h>
 #include <aRibeiroCore/vec4.h>
 
+// forward declaration of the zlib stream state (zlib.h)
+struct z_stream_s;
+
 namespace aRibeiro {
 
 /// \brief Buffered File or Memory Stream Writer.
@@ -20,9 +23,15 @@ namespace aRibeiro {
 ///
 /// It does work in conjunction with the #aRibeiro::BinaryReader, e. g., it can write what that class reads.
 ///
-/// It uses the ZLIB to compress the data and write the file integrity using the #MD5 class.
+/// It uses the ZLIB to compress the data. The files start with a #aRibeiro::BinaryFileHeader
+/// with the uncompressed size and the CRC32 of the data, used to check the file integrity.
+///
+/// With #writeToBuffer and the compressed #writeToFile, the write occurs when you call
+/// the #close method.
 ///
-/// The write occurs when you call the #close method.
+/// With #writeToFileStream and the uncompressed #writeToFile, the data is sent to the
+/// file in chunks while the write methods are called, and the #close writes the last
+/// chunk and the file header.
 ///
 /// Example:
 ///
@@ -52,15 +61,76 @@ class BinaryWriter {
 
     bool compress;
     bool _writeToFile;
+
+    // streaming mode state
+    bool _streaming;
+    size_t streamChunkSize;
+    FILE *streamOut;
+    z_stream_s *zstream;
+    std::vector<uint8_t> zstreamOutput;
+
+    // size estimation mode state
+    bool _counting;
+    size_t writtenCount;
+
+    // the bytes of the buffer in use (the buffer size is the allocated room)
+    size_t bufferUsed;
+    uint8_t *bufferAppend(size_t size);
+
+    // block compression (0 = single ZLIB stream)
+    size_t blockSize;
+
+    // codec used by the block stream
+    uint8_t codecID;
+    int codecLevel;
+    bool codecSelected;
+
+    // CRC32 of the data sent to the stream
+    uint32_t streamCRC;
+
+    // unbuffered (O_DIRECT) file state
+    int directFD;
+    uint8_t *directBuffer;
+    size_t directCapacity;
+    size_t directFilled;
+    uint64_t directOffset;
+
+    // string table of the writeStringRef: string -> index
+    std::map<std::string, uint32_t> stringTable;
+
+    void writeWords(const void *data, size_t count, size_t elementSize, size_t stride, size_t wordSize);
+
+    void streamOpen(const char* filename, bool compress, size_t chunkSize, bool direct);
+    void directWrite(const uint8_t *data, size_t size);
+    void directClose(const uint8_t *header);
+
+    int zlibLevel()const;
+
+    void streamWrite(const uint8_t *data, size_t size, bool finish);
+    void streamFlush(bool finish);
 public:
 
-    std::vector<uint8_t> buffer; ///< Used when the write mode is set to memory.
+    std::vector<uint8_t> buffer; ///< Used when the write mode is set to memory. It has the written data after the #close.
+
+    uint32_t revision; ///< Layout revision of the data-model classes being written (0 = legacy layout).
+
+    bool strict; ///< Abort when a data-model class has data its layout revision does not store (default false: the data is dropped).
 
     BinaryWriter();
     
     /// \brief Create a writer to file
     ///
-    /// The default write mode uses the ZLIB and MD5 to write the file.
+    /// The default write mode uses the ZLIB to write the file.
+    ///
+    /// The file starts with a #aRibeiro::BinaryFileHeader, so the reader detects
+    /// if the file is compressed and checks its integrity.
+    ///
+    /// When compress is true, the data is written by the #close as a block stream
+    /// (#aRibeiro::BinaryStream) with the codec of #setCodec.
+    ///
+    /// When compress is false, the data is written to the file as it arrives,
+    /// through a fixed size buffer (the same as #writeToFileStream). The memory
+    /// used is constant, no matter how big the output is.
     ///
     /// Example:
     ///
@@ -77,13 +147,18 @@ public:
     ///
     /// \author Alessandro Ribeiro
     /// \param filename File to write
-    /// \param compressed If true, uses ZLIB and MD5 to write the stream
+    /// \param compressed If true, uses ZLIB to write the stream
     ///
     void writeToFile(const char* filename, bool compress = true);
 
     /// \brief Create a writer to data allocating in the memory
     ///
-    /// The default write mode uses the ZLIB and MD5 to write the memory stream.
+    /// The default write mode uses the ZLIB to write the memory stream.
+    ///
+    /// The buffer has no #aRibeiro::BinaryFileHeader, it can be embedded in other streams.
+    ///
+    /// The previous content of the #buffer is discarded. After the #close, the #buffer
+    /// has the written data (also when compress is false).
     ///
     /// Example:
     ///
@@ -108,10 +183,214 @@ public:
     /// \endcode
     ///
     /// \author Alessandro Ribeiro
-    /// \param compressed If true, uses ZLIB and MD5 to read the stream
+    /// \param compressed If true, uses ZLIB to write the stream
     ///
     void writeToBuffer(bool compress = true);
 
+    /// \brief Create a writer that streams the data to the file while it is written
+    ///
+    /// The data is collected in chunks of chunkSize bytes. Each time a chunk is complete
+    /// it is sent to the ZLIB deflate (when compress is true) and the output is written
+    /// straight to the file.
+    ///
+    /// The peak memory used by the writer is bounded by the chunk size, no matter how
+    /// big the final stream is.
+    ///
+    /// The output is not the same format as the #writeToFile: the file header is followed
+    /// by a single ZLIB stream, not by a block stream. Both are read by the
+    /// #aRibeiro::BinaryReader (#aRibeiro::BinaryReader::readFromFile and
+    /// #aRibeiro::BinaryReader::readFromFileStream), that detects the format.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFileStream("file.bin");
+    ///
+    /// ...
+    ///
+    /// // flush the last chunk and finish the ZLIB stream
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param filename File to write
+    /// \param compress If true, uses ZLIB to write the stream
+    /// \param chunkSize The amount of bytes collected before send them to the file
+    ///
+    void writeToFileStream(const char* filename, bool compress = true, size_t chunkSize = 64 * 1024);
+
+    /// \brief Create a writer that writes uncompressed data to the file bypassing the OS page cache
+    ///
+    /// Used to export multi-GB files without fill the page cache. The data is copied to an
+    /// aligned buffer of chunkSize bytes, and each full buffer is written with a single
+    /// pwrite to a file opened with O_DIRECT.
+    ///
+    /// On systems or file systems without O_DIRECT support, it works like
+    /// #writeToFileStream without compression.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFileDirect("huge_file.bin");
+    ///
+    /// ...
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param filename File to write
+    /// \param chunkSize The amount of bytes written in each call (rounded to the 4KB alignment)
+    ///
+    void writeToFileDirect(const char* filename, size_t chunkSize = 4 * 1024 * 1024);
+
+    /// \brief Compress the data as independent blocks in parallel
+    ///
+    /// When the #close method is called, the data is split into blocks of blockSize bytes.
+    /// The blocks are compressed in parallel (OpenMP) and written with a block index.
+    /// See #aRibeiro::BinaryStream.
+    ///
+    /// The #aRibeiro::BinaryReader detects the format and decompresses the blocks in parallel.
+    ///
+    /// It has no effect in the streaming mode.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    /// binaryWriter.setBlockCompression( BinaryStream::DefaultBlockSize );
+    ///
+    /// ...
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param blockSize The uncompressed size of each block. 0 writes the single ZLIB stream.
+    ///
+    void setBlockCompression(size_t blockSize);
+
+    /// \brief Select the compression codec and level
+    ///
+    /// The codec identifier is recorded in the stream header (see #aRibeiro::BinaryStream),
+    /// so the #aRibeiro::BinaryReader selects the decoder automatically.
+    ///
+    /// The built-in codecs are: #BinaryCodec_STORE (no compression), #BinaryCodec_ZLIB and #BinaryCodec_RLE.
+    /// User codecs can be added with #aRibeiro::BinaryCodec::registerCodec.
+    ///
+    /// The streaming mode always writes a ZLIB stream, using the selected level.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// // CI builds: speed over ratio
+    /// binaryWriter.setCodec( BinaryCodec_ZLIB, BinaryCodecLevel_FASTEST );
+    ///
+    /// // shipping builds: maximum ratio
+    /// binaryWriter.setCodec( BinaryCodec_ZLIB, BinaryCodecLevel_BEST );
+    ///
+    /// ...
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param codecID The codec identifier (see #aRibeiro::BinaryCodecID)
+    /// \param level The compression level (see #aRibeiro::BinaryCodecLevel)
+    ///
+    void setCodec(uint8_t codecID, int level = -1);
+
+    /// \brief Create a writer that only counts the bytes written
+    ///
+    /// No data is stored. It is used to estimate the serialized size of a
+    /// structure before the real write, to #reserve the exact buffer size.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter counter;
+    /// counter.writeToCounter();
+    /// // ... write methods ...
+    ///
+    /// BinaryWriter binaryWriter;
+    /// binaryWriter.writeToBuffer();
+    /// binaryWriter.reserve( counter.writtenSize() );
+    /// // ... write methods ...
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    ///
+    void writeToCounter();
+
+    /// \brief The amount of uncompressed bytes written since the writer was created or reset
+    ///
+    /// \author Alessandro Ribeiro
+    /// \return the amount of bytes written
+    ///
+    size_t writtenSize() const;
+
+    /// \brief Write zero bytes up to the next multiple of alignment, counting from the start of the data
+    ///
+    /// The reader skips the padding with #aRibeiro::BinaryReader::readAlign.
+    ///
+    /// Used before arrays that are read in place (#aRibeiro::BinaryReader::readPointer).
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param alignment the alignment in bytes
+    ///
+    void writeAlign(size_t alignment);
+
+    /// \brief Pre-allocate the internal buffer
+    ///
+    /// After this call, the writes up to size bytes do not cause any reallocation.
+    ///
+    /// It has no effect in the streaming mode, where the buffer is bounded by the chunk size.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToBuffer();
+    /// binaryWriter.reserve( 1024 * 1024 );
+    ///
+    /// ...
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param size The amount of bytes to pre-allocate
+    ///
+    void reserve(size_t size);
+
     ~BinaryWriter();
 
     /// \brief Reset the current write state and start it over
@@ -185,6 +464,38 @@ public:
     ///
     void write(void *data, size_t size);
 
+    /// \brief Write an array of elements with one buffer growth and one copy pass.
+    ///
+    /// Each element has elementSize bytes in the stream, and it is read from the
+    /// input with a distance of stride bytes between elements.
+    ///
+    /// It is used to write arrays where the memory layout is padded (like the vec3 with SSE2).
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// // write 3 floats from each 16 bytes vec3
+    /// aligned_vector<vec3> data_to_write;
+    /// binaryWriter.writeStrided( &data_to_write[0], data_to_write.size(), sizeof(float) * 3, sizeof(vec3) );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param data The pointer to the data to write
+    /// \param count The number of elements to write
+    /// \param elementSize The size of each element in the stream
+    /// \param stride The distance in bytes between two elements in the input buffer
+    ///
+    void writeStrided(const void *data, size_t count, size_t elementSize, size_t stride);
+
     /// \brief Write 1 byte unsigned integer (uint8_t)
     ///
     /// Example:
@@ -323,6 +634,79 @@ public:
     ///
     void writeInt32(int32_t v);
 
+    /// \brief Write 8 bytes unsigned integer (uint64_t)
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// uint64_t data_to_write;
+    /// binaryWriter.writeUInt64( data_to_write );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param v 8 bytes unsigned integer (uint64_t)
+    ///
+    void writeUInt64(uint64_t v);
+
+    /// \brief Write a LEB128 variable length unsigned integer (1 to 5 bytes)
+    ///
+    /// Values below 128 use 1 byte, below 16384 use 2 bytes, and so on.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// uint32_t data_to_write;
+    /// binaryWriter.writeVarUInt32( data_to_write );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param v 4 bytes unsigned integer (uint32_t)
+    ///
+    void writeVarUInt32(uint32_t v);
+
+    /// \brief Write a zigzag LEB128 variable length signed integer (1 to 5 bytes)
+    ///
+    /// The zigzag maps the small negative values to small unsigned values (0, -1, 1, -2 ... to 0, 1, 2, 3 ...).
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// int32_t data_to_write;
+    /// binaryWriter.writeVarInt32( data_to_write );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param v 4 bytes signed integer (int32_t)
+    ///
+    void writeVarInt32(int32_t v);
+
     /// \brief Write 4 bytes single precision float point number (float)
     ///
     /// Example:
@@ -484,6 +868,38 @@ public:
     ///
     void writeString(const std::string &s);
 
+    /// \brief Write a string through the string table of the stream
+    ///
+    /// The first time a string is written, it is stored in the stream and added to the table.
+    /// The next times only its index in the table is written (a varint).
+    ///
+    /// Used for names that repeat a lot (bone names, node names, material keys).
+    ///
+    /// The table starts empty when the writer is opened, so the reader need to read
+    /// the strings in the same order with #aRibeiro::BinaryReader::readStringRef.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// // the second call writes 1 byte
+    /// binaryWriter.writeStringRef( "Armature_Bone" );
+    /// binaryWriter.writeStringRef( "Armature_Bone" );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param s 8bits character sequence string, ASCII (std::string)
+    ///
+    void writeStringRef(const std::string &s);
+
     /// \brief Write STL vector of single precision float
     ///
     /// Example:
@@ -553,6 +969,32 @@ public:
     ///
     void writeVectorUInt32(const std::vector<uint32_t> &v);
 
+    /// \brief Write STL vector of unsigned 4bytes integer as delta coded varints
+    ///
+    /// Each element is written as the zigzag varint of the difference to the previous element.
+    /// Sorted or almost sorted index lists use 1 or 2 bytes per element.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// std::vector<uint32_t> data_to_write;
+    /// binaryWriter.writeVectorUInt32Delta( data_to_write );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param v STL vector of unsigned 4bytes integer
+    ///
+    void writeVectorUInt32Delta(const std::vector<uint32_t> &v);
+
     /// \brief Write aligned_vector of 8 bytes 2D vectors
     ///
     /// Example:
@@ -599,6 +1041,31 @@ public:
     ///
     void writeVectorVec3(const aligned_vector<vec3> &v);
 
+    /// \brief Write aligned_vector of 3D vectors with only the x and y components (8 bytes each)
+    ///
+    /// Used for the texture coordinates stored in vec3. Read it with BinaryReader::readVectorVec3XY.
+    ///
+    /// Example:
+    ///
+    /// \code
+    /// #include <aRibeiroCore/aRibeiroCore.h>
+    /// using namespace aRibeiro;
+    ///
+    /// BinaryWriter binaryWriter;
+    ///
+    /// binaryWriter.writeToFile("file.bin");
+    ///
+    /// aligned_vector<vec3> uv;
+    /// binaryWriter.writeVectorVec3XY( uv );
+    ///
+    /// binaryWriter.close();
+    /// \endcode
+    ///
+    /// \author Alessandro Ribeiro
+    /// \param v aligned_vector of 3D vectors (the z is not written)
+    ///
+    void writeVectorVec3XY(const aligned_vector<vec3> &v);
+
     /// \brief Write aligned_vector of 16 bytes 3D vectors with Homogeneous coord
     ///
     /// Example:
@@ -9,6 +9,8 @@
 
 #include "NodeAnimation.h"
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE Animation {
@@ -18,22 +20,21 @@ namespace model {
         float ticksPerSecond;
         aRibeiro::aligned_vector<NodeAnimation> channels;
 
-        void write(aRibeiro::BinaryWriter* writer) const
-        {
-            writer->writeString(name);
-            writer->writeFloat(durationTicks);
-            writer->writeFloat(ticksPerSecond);
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+            v.pod("durationTicks", durationTicks);
+            v.pod("ticksPerSecond", ticksPerSecond);
             
-            aRibeiro::BinaryWriter_WriteAlignedVector<NodeAnimation>(writer,channels);
+            v.objects("channels", channels);
         }
 
-        void read(aRibeiro::BinaryReader* reader) 
-        {
-            name = reader->readString();
-            durationTicks = reader->readFloat();
-            ticksPerSecond = reader->readFloat();
-            
-            aRibeiro::BinaryReader_ReadAlignedVector<NodeAnimation>(reader,&channels);
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
         }
         
         Animation() {
@@ -0,0 +1,314 @@
+#ifndef model_animation_sampler_h_
+#define model_animation_sampler_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <vector>
+#include <math.h>
+
+#include "Animation.h"
+
+namespace model {
+
+    // Samples all the channels of an Animation at a time (in ticks).
+    //
+    // Each key track (position, rotation and scaling of each channel) keeps a cursor
+    // with its last key: the forward playback advances the cursor a few keys, and the
+    // seeks (or the loop of AnimBehaviour_REPEAT) use a binary search.
+    //
+    // The position and scaling are linear interpolated. The rotation is nlerp
+    // (normalized linear interpolation in the shortest path), 4 channels at a time with SSE2.
+    //
+    // The time outside the keys range uses the preState/postState of the channel.
+    // With AnimBehaviour_DEFAULT the track is not in the flags of the channel:
+    // use the node transform.
+    //
+    // The setAnimation allocates the arrays, the sample makes no allocation.
+    //
+    // Example:
+    //
+    //   model::AnimationSampler sampler;
+    //   sampler.setAnimation(&container->animations[0]);
+    //
+    //   // each frame
+    //   sampler.sample(seconds * animation.ticksPerSecond);
+    //   for (size_t i = 0; i < sampler.flags.size(); i++) {
+    //       if (sampler.flags[i] & model::AnimationSample_Position)
+    //           node[i]->LocalPosition = sampler.position[i];
+    //       ...
+    //   }
+    //
+
+    const uint8_t AnimationSample_Position = (1 << 0);
+    const uint8_t AnimationSample_Rotation = (1 << 1);
+    const uint8_t AnimationSample_Scaling = (1 << 2);
+
+    class _SSE2_ALIGN_PRE AnimationSampler {
+
+        // the keys a and b, and the interpolation factor between them
+        struct Segment {
+            uint32_t a;
+            uint32_t b;
+            float factor;
+        };
+
+        const Animation *animation;
+
+        // position, rotation and scaling of each channel
+        std::vector<uint32_t> cursor;
+
+        // the rotation keys of the sample: nlerp in blocks of 4 channels
+        std::vector<const aRibeiro::quat *> rotationA;
+        std::vector<const aRibeiro::quat *> rotationB;
+        std::vector<float> rotationFactor;
+
+        aRibeiro::quat identity;
+
+        // the last key i with keys[i].time <= time, in [first..last]
+        template <typename K>
+        static uint32_t search(const aRibeiro::aligned_vector<K> &keys, float time, uint32_t first, uint32_t last) {
+            while (first < last) {
+                uint32_t middle = first + (last - first + 1) / 2;
+                if (keys[middle].time <= time)
+                    first = middle;
+                else
+                    last = middle - 1;
+            }
+            return first;
+        }
+
+        // returns false when the track has no value at the time (no keys, or AnimBehaviour_DEFAULT)
+        template <typename K>
+        static bool locate(const aRibeiro::aligned_vector<K> &keys, float time, AnimBehaviour preState, AnimBehaviour postState,
+                           uint32_t *cursor, Segment *segment) {
+            uint32_t count = (uint32_t)keys.size();
+            if (count == 0)
+                return false;
+            float first = keys[0].time;
+            float last = keys[count - 1].time;
+
+            if (time < first || time > last) {
+                AnimBehaviour behaviour = (time < first) ? preState : postState;
+                uint32_t nearest = (time < first) ? 0 : count - 1;
+                float range = last - first;
+                switch (behaviour) {
+                    case AnimBehaviour_CONSTANT:
+                        break;
+                    case AnimBehaviour_LINEAR:
+                        if (count > 1 && range > 0.0f) {
+                            // the first or the last two keys, extrapolated
+                            segment->a = (time < first) ? 0 : count - 2;
+                            segment->b = segment->a + 1;
+                            float dt = keys[segment->b].time - keys[segment->a].time;
+                            segment->factor = (dt > 0.0f) ? (time - keys[segment->a].time) / dt : 0.0f;
+                            return true;
+                        }
+                        break;
+                    case AnimBehaviour_REPEAT:
+                        if (range > 0.0f) {
+                            time -= floorf((time - first) / range) * range;
+                            time = (time < first) ? first : ((time > last) ? last : time);
+                            nearest = count;
+                        }
+                        break;
+                    default:
+                        return false;
+                }
+                if (nearest < count) {
+                    segment->a = segment->b = nearest;
+                    segment->factor = 0.0f;
+                    return true;
+                }
+            }
+
+            if (count == 1) {
+                segment->a = segment->b = 0;
+                segment->factor = 0.0f;
+                return true;
+            }
+
+            // the segment [i..i+1] with the time, i in [0..count-2]
+            uint32_t i = (*cursor < count - 1) ? *cursor : 0;
+            if (keys[i].time <= time) {
+                // forward playback: a few keys after the last sample
+                for (int step = 0; step < 4 && i + 1 < count - 1 && keys[i + 1].time <= time; step++)
+                    i++;
+                if (i + 1 < count - 1 && keys[i + 1].time <= time)
+                    i = search(keys, time, i + 1, count - 2);
+            } else
+                i = search(keys, time, 0, i);
+            *cursor = i;
+
+            segment->a = i;
+            segment->b = i + 1;
+            float dt = keys[i + 1].time - keys[i].time;
+            float factor = (dt > 0.0f) ? (time - keys[i].time) / dt : 0.0f;
+            segment->factor = (factor < 0.0f) ? 0.0f : ((factor > 1.0f) ? 1.0f : factor);
+            return true;
+        }
+
+#if defined(ARIBEIRO_SSE2)
+        static void prefetch(const NodeAnimation &channel, const uint32_t *cursor) {
+            if (cursor[0] < channel.positionKeys.size())
+                _mm_prefetch((const char *)&channel.positionKeys[cursor[0]], _MM_HINT_T0);
+            if (cursor[1] < channel.rotationKeys.size())
+                _mm_prefetch((const char *)&channel.rotationKeys[cursor[1]], _MM_HINT_T0);
+            if (cursor[2] < channel.scalingKeys.size())
+                _mm_prefetch((const char *)&channel.scalingKeys[cursor[2]], _MM_HINT_T0);
+        }
+#endif
+
+        static aRibeiro::vec3 sampleVec3(const aRibeiro::aligned_vector<Vec3Key> &keys, const Segment &segment) {
+            const aRibeiro::vec3 &a = keys[segment.a].value;
+            if (segment.factor == 0.0f)
+                return a;
+            return aRibeiro::lerp(a, keys[segment.b].value, segment.factor);
+        }
+
+        // nlerp of the rotations of the channels
+        void nlerp(size_t count) {
+            size_t i = 0;
+#if defined(ARIBEIRO_SSE2)
+            const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000u));
+            for (; i + 4 <= count; i += 4) {
+                // x, y, z and w of 4 rotations in each register
+                __m128 ax = _mm_loadu_ps((const float *)rotationA[i]);
+                __m128 ay = _mm_loadu_ps((const float *)rotationA[i + 1]);
+                __m128 az = _mm_loadu_ps((const float *)rotationA[i + 2]);
+                __m128 aw = _mm_loadu_ps((const float *)rotationA[i + 3]);
+                _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+                __m128 bx = _mm_loadu_ps((const float *)rotationB[i]);
+                __m128 by = _mm_loadu_ps((const float *)rotationB[i + 1]);
+                __m128 bz = _mm_loadu_ps((const float *)rotationB[i + 2]);
+                __m128 bw = _mm_loadu_ps((const float *)rotationB[i + 3]);
+                _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+                __m128 t = _mm_loadu_ps(&rotationFactor[i]);
+
+                // shortest path: b negated when dot(a, b) < 0
+                __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                                        _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+                __m128 sign = _mm_and_ps(dot, signMask);
+                bx = _mm_xor_ps(bx, sign);
+                by = _mm_xor_ps(by, sign);
+                bz = _mm_xor_ps(bz, sign);
+                bw = _mm_xor_ps(bw, sign);
+
+                __m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+                __m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+                __m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+                __m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                                       _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+                __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), length);
+                x = _mm_mul_ps(x, inv);
+                y = _mm_mul_ps(y, inv);
+                z = _mm_mul_ps(z, inv);
+                w = _mm_mul_ps(w, inv);
+
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+                _mm_storeu_ps((float *)&rotation[i], x);
+                _mm_storeu_ps((float *)&rotation[i + 1], y);
+                _mm_storeu_ps((float *)&rotation[i + 2], z);
+                _mm_storeu_ps((float *)&rotation[i + 3], w);
+            }
+#endif
+            for (; i < count; i++) {
+                const aRibeiro::quat &a = *rotationA[i];
+                aRibeiro::quat b = *rotationB[i];
+                float t = rotationFactor[i];
+                if (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.0f)
+                    b = aRibeiro::quat(-b.x, -b.y, -b.z, -b.w);
+                float x = a.x + (b.x - a.x) * t;
+                float y = a.y + (b.y - a.y) * t;
+                float z = a.z + (b.z - a.z) * t;
+                float w = a.w + (b.w - a.w) * t;
+                float inv = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+                rotation[i] = aRibeiro::quat(x * inv, y * inv, z * inv, w * inv);
+            }
+        }
+
+    public:
+
+        // one element per animation channel
+        aRibeiro::aligned_vector<aRibeiro::vec3> position;
+        aRibeiro::aligned_vector<aRibeiro::quat> rotation;
+        aRibeiro::aligned_vector<aRibeiro::vec3> scaling;
+        std::vector<uint8_t> flags; // AnimationSample_Position | AnimationSample_Rotation | AnimationSample_Scaling
+
+        AnimationSampler() {
+            animation = NULL;
+            identity = aRibeiro::quat(0, 0, 0, 1);
+        }
+
+        // the animation must stay valid while it is sampled
+        void setAnimation(const Animation *animation) {
+            this->animation = animation;
+            size_t count = (animation != NULL) ? animation->channels.size() : 0;
+            cursor.assign(count * 3, 0);
+            rotationA.resize(count);
+            rotationB.resize(count);
+            rotationFactor.resize(count);
+            position.resize(count);
+            rotation.resize(count);
+            scaling.resize(count);
+            flags.assign(count, 0);
+        }
+
+        // the cursors back to the first key
+        void reset() {
+            for (size_t i = 0; i < cursor.size(); i++)
+                cursor[i] = 0;
+        }
+
+        // time in ticks (seconds * animation.ticksPerSecond)
+        void sample(float time) {
+            if (animation == NULL)
+                return;
+            const aRibeiro::aligned_vector<NodeAnimation> &channels = animation->channels;
+            if (flags.size() != channels.size())
+                setAnimation(animation);
+            for (size_t c = 0; c < channels.size(); c++) {
+#if defined(ARIBEIRO_SSE2)
+                // the channels and the keys at the cursors ahead: each key array is a separate allocation
+                if (c + 8 < channels.size())
+                    _mm_prefetch((const char *)&channels[c + 8], _MM_HINT_T0);
+                if (c + 4 < channels.size())
+                    prefetch(channels[c + 4], &cursor[(c + 4) * 3]);
+#endif
+                const NodeAnimation &channel = channels[c];
+                uint8_t channelFlags = 0;
+                Segment segment;
+
+                if (locate(channel.positionKeys, time, channel.preState, channel.postState, &cursor[c * 3], &segment)) {
+                    position[c] = sampleVec3(channel.positionKeys, segment);
+                    channelFlags |= AnimationSample_Position;
+                } else
+                    position[c] = aRibeiro::vec3(0);
+
+                if (locate(channel.rotationKeys, time, channel.preState, channel.postState, &cursor[c * 3 + 1], &segment)) {
+                    rotationA[c] = &channel.rotationKeys[segment.a].value;
+                    rotationB[c] = &channel.rotationKeys[segment.b].value;
+                    rotationFactor[c] = segment.factor;
+                    channelFlags |= AnimationSample_Rotation;
+                } else {
+                    rotationA[c] = rotationB[c] = &identity;
+                    rotationFactor[c] = 0.0f;
+                }
+
+                if (locate(channel.scalingKeys, time, channel.preState, channel.postState, &cursor[c * 3 + 2], &segment)) {
+                    scaling[c] = sampleVec3(channel.scalingKeys, segment);
+                    channelFlags |= AnimationSample_Scaling;
+                } else
+                    scaling[c] = aRibeiro::vec3(1);
+
+                flags[c] = channelFlags;
+            }
+            nlerp(channels.size());
+        }
+
+        SSE2_CLASS_NEW_OPERATOR
+    }_SSE2_ALIGN_POS;
+
+}
+
+#endif
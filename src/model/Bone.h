@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE VertexWeight {
@@ -14,14 +16,18 @@ namespace model {
         uint32_t vertexID;
         float weight;
         
+        template <typename V>
+        void fields(V &v) {
+            v.pod("vertexID", vertexID);
+            v.pod("weight", weight);
+        }
+
         void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeUInt32(vertexID);
-            writer->writeFloat(weight);
+            ModelFields_Write(writer, *this);
         }
         
         void read(aRibeiro::BinaryReader* reader) {
-            vertexID = reader->readUInt32();
-            weight = reader->readFloat();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -34,16 +40,44 @@ namespace model {
 
         //aRibeiro::mat4 offset;
 
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+            //v.pod("offset", offset);
+            if (v.revision >= ModelRevision_Varint)
+                v.custom("weights", 1, *this, &Bone::writeWeights, &Bone::readWeights);
+            else
+                v.objects("weights", weights);
+        }
+
+        // the weights are usually sorted by vertexID: delta coded ids
+        void writeWeights(aRibeiro::BinaryWriter* writer) const{
+            writer->writeVarUInt32((uint32_t)weights.size());
+            uint32_t previous = 0;
+            for (size_t i = 0; i < weights.size(); i++) {
+                writer->writeVarInt32((int32_t)(weights[i].vertexID - previous));
+                writer->writeFloat(weights[i].weight);
+                previous = weights[i].vertexID;
+            }
+        }
+
+        void readWeights(aRibeiro::BinaryReader* reader) {
+            // each weight has at least 1 byte vertexID and the 4 bytes float
+            weights.resize(reader->validateCount(reader->readVarUInt32(), 1 + sizeof(float)));
+            uint32_t previous = 0;
+            for (size_t i = 0; i < weights.size(); i++) {
+                previous += (uint32_t)reader->readVarInt32();
+                weights[i].vertexID = previous;
+                weights[i].weight = reader->readFloat();
+            }
+        }
+
         void write(aRibeiro::BinaryWriter* writer) const{
-            writer->writeString(name);
-            //writer->writeMat4(offset);
-            aRibeiro::BinaryWriter_WriteAlignedVector<VertexWeight>(writer, weights);
+            ModelFields_Write(writer, *this);
         }
 
         void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
-            //offset = reader->readMat4();
-            aRibeiro::BinaryReader_ReadAlignedVector<VertexWeight>(reader, &weights);
+            ModelFields_Read(reader, this);
         }
 
         Bone() {
@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE Camera {
@@ -31,35 +33,28 @@ namespace model {
             return height * aspect;
         }
 
-        void write(aRibeiro::BinaryWriter* writer)const {
-            
-            writer->writeString(name);
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
 
-            writer->writeVec3(pos);
-            writer->writeVec3(up);
-            writer->writeVec3(forward);
+            v.pod("pos", pos);
+            v.pod("up", up);
+            v.pod("forward", forward);
 
-            writer->writeFloat(horizontalFOVrad);
-            writer->writeFloat(nearPlane);
-            writer->writeFloat(farPlane);
-            writer->writeFloat(aspect);
+            v.pod("horizontalFOVrad", horizontalFOVrad);
+            v.pod("nearPlane", nearPlane);
+            v.pod("farPlane", farPlane);
+            v.pod("aspect", aspect);
 
-            writer->writeFloat(verticalFOVrad);
+            v.pod("verticalFOVrad", verticalFOVrad);
         }
 
-        void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
-
-            pos = reader->readVec3();
-            up = reader->readVec3();
-            forward = reader->readVec3();
-
-            horizontalFOVrad = reader->readFloat();
-            nearPlane = reader->readFloat();
-            farPlane = reader->readFloat();
-            aspect = reader->readFloat();
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
 
-            verticalFOVrad = reader->readFloat();
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
         }
         
         Camera() {
@@ -9,6 +9,9 @@
 
 #include "Bone.h"
 
+#include "ModelFields.h"
+#include "GeometryQuantization.h"
+
 namespace model {
 
     //enum VertexFormat {
@@ -65,72 +68,239 @@ namespace model {
         aRibeiro::aligned_vector<aRibeiro::vec4> color[8];//RGBA
         //std::vector<uint32_t> color[8];//RGBA
 
-        std::vector<uint16_t> indice;
+        std::vector<uint32_t> indice;
 
         uint32_t materialIndex;
 
         aRibeiro::aligned_vector<Bone> bones;
 
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeString(name);
+        // GeometryQuantize_Pos16 | GeometryQuantize_NormalOct16 | ...
+        // the attributes quantized in the stream (set by the read)
+        uint32_t quantization;
+
+        // true: the read keeps the quantized attributes in 'quantized' as they are (to upload to the GPU),
+        // and their float arrays stay empty
+        bool keepQuantized;
+        GeometryQuantized quantized;
+
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
 
             //VertexFormat: CONTAINS_POS | CONTAINS_NORMAL | ...
-            writer->writeUInt32(format);
-            writer->writeUInt32(vertexCount);
-            writer->writeUInt32(indiceCountPerFace);// 1 - points, 2 - lines, 3 - triangles, 4 - quads
-            writer->writeUInt32(materialIndex);
+            v.pod("format", format);
+            if (v.revision >= ModelRevision_Varint) {
+                v.varuint("vertexCount", vertexCount);
+                v.varuint("indiceCountPerFace", indiceCountPerFace);
+                v.varuint("materialIndex", materialIndex);
+            } else {
+                v.pod("vertexCount", vertexCount);
+                v.pod("indiceCountPerFace", indiceCountPerFace);// 1 - points, 2 - lines, 3 - triangles, 4 - quads
+                v.pod("materialIndex", materialIndex);
+            }
 
-            writer->writeVectorVec3(pos);
-            writer->writeVectorVec3(normals);
-            writer->writeVectorVec3(tangent);
+            if (v.revision >= ModelRevision_Quantized) {
+                // the layout of each attribute depends on the quantization
+                v.custom("attributes", 1, *this, &Geometry::writeAttributes, &Geometry::readAttributes);
+            } else {
+                // not stored before the quantized revision
+                v.readReset("quantization", *this, &Geometry::resetQuantization);
+                v.array("pos", pos);
+                v.array("normals", normals);
+                v.array("tangent", tangent);
+                v.array("binormal", binormal);
+
+                if (v.revision >= ModelRevision_Channels) {
+                    // the channels written depend on the format
+                    v.custom("channels", 1, *this, &Geometry::writeChannels, &Geometry::readChannels);
+                } else {
+                    for (int i = 0; i < 8; i++)
+                        v.array("uv", uv[i]);
+                    for (int i = 0; i < 8; i++)
+                        v.array("color", color[i]);//RGBA
+                }
+            }
+            if (v.revision >= ModelRevision_Indices)
+                v.indices("indice", indice);
+            else
+                v.indices16("indice", indice);
+
+            v.objects("bones", bones);
+        }
 
-            //for (size_t i = 0; i < normals.size(); i++)
-                //printf("%f\n", distance(binormal[i], cross(normals[i], tangent[i])));
-            writer->writeVectorVec3(binormal);
+        // The channel layouts store only the uv and color channels present in the format,
+        // and the uv with 2 components. The strict writer aborts instead of dropping the data.
+        void checkChannels(const aRibeiro::BinaryWriter* writer)const {
+            if (!writer->strict)
+                return;
+            for (int i = 0; i < 8; i++) {
+                ARIBEIRO_ABORT(!(format & (CONTAINS_UV0 << i)) && (uv[i].size() > 0 || quantized.uv[i].size() > 0),
+                    "Geometry uv channel %i has data, but it is not in the format.\n", i);
+                ARIBEIRO_ABORT(!(format & (CONTAINS_COLOR0 << i)) && (color[i].size() > 0 || quantized.color[i].size() > 0),
+                    "Geometry color channel %i has data, but it is not in the format.\n", i);
+                for (size_t j = 0; j < uv[i].size(); j++)
+                    ARIBEIRO_ABORT(uv[i][j].z != 0.0f, "Geometry uv channel %i has a z component, the uv is written with 2 components.\n", i);
+            }
+        }
 
+        // only the uv and color channels present in the format (the others are not written),
+        // the uv with 2 components
+        void writeChannels(aRibeiro::BinaryWriter* writer)const {
+            checkChannels(writer);
             for (int i = 0; i < 8; i++)
-                writer->writeVectorVec3(uv[i]);
+                if (format & (CONTAINS_UV0 << i))
+                    writer->writeVectorVec3XY(uv[i]);
             for (int i = 0; i < 8; i++)
-                writer->writeVectorVec4(color[i]);
-            //writer->writeVectorUInt32(color[i]);//RGBA
-            writer->writeVectorUInt16(indice);
+                if (format & (CONTAINS_COLOR0 << i))
+                    writer->writeVectorVec4(color[i]);//RGBA
+        }
 
-            aRibeiro::BinaryWriter_WriteAlignedVector<Bone>(writer, bones);
+        // the absent channels are cleared without reading or allocating
+        void readChannels(aRibeiro::BinaryReader* reader) {
+            for (int i = 0; i < 8; i++) {
+                if (format & (CONTAINS_UV0 << i))
+                    reader->readVectorVec3XY(&uv[i]);
+                else
+                    uv[i].clear();
+            }
+            for (int i = 0; i < 8; i++) {
+                if (format & (CONTAINS_COLOR0 << i))
+                    reader->readVectorVec4(&color[i]);//RGBA
+                else
+                    color[i].clear();
+            }
         }
 
-        void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
+        // varuint quantization | pos | normals | tangent | binormal | uv and color channels in the format
+        //
+        // Each attribute is the float array, or the quantized array when its GeometryQuantize_* flag is set.
+        // The quantized position has the bounds (vec3 min, vec3 max) before the array.
+        // A geometry read with keepQuantized writes its quantized arrays as they are.
+        void writeAttributes(aRibeiro::BinaryWriter* writer)const {
+            checkChannels(writer);
+            writer->writeVarUInt32(quantization);
+
+            if (quantization & GeometryQuantize_Pos16) {
+                if (pos.size() > 0) {
+                    aRibeiro::vec3 min, max;
+                    std::vector<uint16_t> packed;
+                    GeometryQuantization::bounds(pos, &min, &max);
+                    GeometryQuantization::encodePos(pos, min, max, &packed);
+                    writer->writeVec3(min);
+                    writer->writeVec3(max);
+                    writer->writeVectorUInt16(packed);
+                } else {
+                    writer->writeVec3(quantized.boundsMin);
+                    writer->writeVec3(quantized.boundsMax);
+                    writer->writeVectorUInt16(quantized.pos);
+                }
+            } else
+                writer->writeVectorVec3(pos);
+
+            std::vector<uint32_t> packed;
+            bool oct = (quantization & GeometryQuantize_NormalOct16) != 0;
+            writePacked(writer, oct, normals, quantized.normals, &GeometryQuantization::encodeOct, &aRibeiro::BinaryWriter::writeVectorVec3, &packed);
+            writePacked(writer, oct, tangent, quantized.tangent, &GeometryQuantization::encodeOct, &aRibeiro::BinaryWriter::writeVectorVec3, &packed);
+            writePacked(writer, oct, binormal, quantized.binormal, &GeometryQuantization::encodeOct, &aRibeiro::BinaryWriter::writeVectorVec3, &packed);
 
-            //VertexFormat: CONTAINS_POS | CONTAINS_NORMAL | ...
-            format = reader->readUInt32();
-            vertexCount = reader->readUInt32();
-            indiceCountPerFace = reader->readUInt32();// 1 - points, 2 - lines, 3 - triangles, 4 - quads
-            materialIndex = reader->readUInt32();
+            for (int i = 0; i < 8; i++)
+                if (format & (CONTAINS_UV0 << i))
+                    writePacked(writer, (quantization & GeometryQuantize_UVHalf) != 0, uv[i], quantized.uv[i], &GeometryQuantization::encodeHalf2, &aRibeiro::BinaryWriter::writeVectorVec3XY, &packed);
+            for (int i = 0; i < 8; i++)
+                if (format & (CONTAINS_COLOR0 << i))
+                    writePacked(writer, (quantization & GeometryQuantize_ColorUNorm8) != 0, color[i], quantized.color[i], &GeometryQuantization::encodeUNorm8, &aRibeiro::BinaryWriter::writeVectorVec4, &packed);
+        }
+
+        // the quantized attributes are decoded to the float arrays (SSE2),
+        // or kept in 'quantized' with keepQuantized
+        void readAttributes(aRibeiro::BinaryReader* reader) {
+            quantization = reader->readVarUInt32();
+            quantized.clear();
+
+            if (quantization & GeometryQuantize_Pos16) {
+                quantized.boundsMin = reader->readVec3();
+                quantized.boundsMax = reader->readVec3();
+                reader->readVectorUInt16(&quantized.pos);
+                if (keepQuantized)
+                    pos.clear();
+                else {
+                    GeometryQuantization::decodePos(quantized.pos, quantized.boundsMin, quantized.boundsMax, &pos);
+                    quantized.pos.clear();
+                }
+            } else
+                reader->readVectorVec3(&pos);
+
+            bool oct = (quantization & GeometryQuantize_NormalOct16) != 0;
+            readPacked(reader, oct, &normals, &quantized.normals, &GeometryQuantization::decodeOct, &aRibeiro::BinaryReader::readVectorVec3);
+            readPacked(reader, oct, &tangent, &quantized.tangent, &GeometryQuantization::decodeOct, &aRibeiro::BinaryReader::readVectorVec3);
+            readPacked(reader, oct, &binormal, &quantized.binormal, &GeometryQuantization::decodeOct, &aRibeiro::BinaryReader::readVectorVec3);
 
-            reader->readVectorVec3(&pos);
-            reader->readVectorVec3(&normals);
-            reader->readVectorVec3(&tangent);
+            for (int i = 0; i < 8; i++) {
+                if (format & (CONTAINS_UV0 << i))
+                    readPacked(reader, (quantization & GeometryQuantize_UVHalf) != 0, &uv[i], &quantized.uv[i], &GeometryQuantization::decodeHalf2, &aRibeiro::BinaryReader::readVectorVec3XY);
+                else
+                    uv[i].clear();
+            }
+            for (int i = 0; i < 8; i++) {
+                if (format & (CONTAINS_COLOR0 << i))
+                    readPacked(reader, (quantization & GeometryQuantize_ColorUNorm8) != 0, &color[i], &quantized.color[i], &GeometryQuantization::decodeUNorm8, &aRibeiro::BinaryReader::readVectorVec4);
+                else
+                    color[i].clear();
+            }
+        }
 
-            //binormal.resize(normals.size());
-            //for (size_t i = 0; i < normals.size(); i++)
-                //binormal[i] = cross(normals[i], tangent[i]);
-            reader->readVectorVec3(&binormal);
+        // the older revisions read the float arrays only
+        void resetQuantization() {
+            quantization = GeometryQuantize_None;
+            quantized.clear();
+        }
 
-            for (int i = 0; i < 8; i++)
-                reader->readVectorVec3(&uv[i]);
-            for (int i = 0; i < 8; i++)
-                reader->readVectorVec4(&color[i]);
-            //reader->readVectorUInt32(&color[i]);//RGBA
-            reader->readVectorUInt16(&indice);
+        // the float array, the encoded float array, or the kept quantized array when the float array is empty
+        template <typename A>
+        static void writePacked(aRibeiro::BinaryWriter* writer, bool quantize, const A &values, const std::vector<uint32_t> &kept,
+                                void (*encode)(const A &, std::vector<uint32_t> *), void (aRibeiro::BinaryWriter::*writeFloat)(const A &),
+                                std::vector<uint32_t> *packed) {
+            if (!quantize)
+                (writer->*writeFloat)(values);
+            else if (values.size() == 0)
+                writer->writeVectorUInt32(kept);
+            else {
+                encode(values, packed);
+                writer->writeVectorUInt32(*packed);
+            }
+        }
+
+        template <typename A>
+        void readPacked(aRibeiro::BinaryReader* reader, bool quantize, A *values, std::vector<uint32_t> *kept,
+                        void (*decode)(const std::vector<uint32_t> &, A *), void (aRibeiro::BinaryReader::*readFloat)(A *)) {
+            if (!quantize) {
+                (reader->*readFloat)(values);
+                return;
+            }
+            reader->readVectorUInt32(kept);
+            if (keepQuantized)
+                values->clear();
+            else {
+                decode(*kept, values);
+                kept->clear();
+            }
+        }
 
-            aRibeiro::BinaryReader_ReadAlignedVector<Bone>(reader, &bones);
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
         }
 
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
+        }
+        
         Geometry() {
             format = 0; //CONTAINS_POS | CONTAINS_NORMAL | ...
             vertexCount = 0;
             indiceCountPerFace = 0;// 1 - points, 2 - lines, 3 - triangles, 4 - quads
             materialIndex = 0;
+            quantization = GeometryQuantize_None;
+            keepQuantized = false;
         }
 
         //copy constructores
@@ -160,6 +330,10 @@ namespace model {
 
             bones = v.bones;
 
+            quantization = v.quantization;
+            keepQuantized = v.keepQuantized;
+            quantized = v.quantized;
+
         }
 
         SSE2_CLASS_NEW_OPERATOR
@@ -0,0 +1,717 @@
+#ifndef model_geometry_optimizer_h_
+#define model_geometry_optimizer_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h> // memcpy
+
+#include "Geometry.h"
+#include "IndexBuffer.h"
+
+namespace model {
+
+    // Post-transform vertex cache statistics of a triangle list (FIFO cache simulation).
+    //
+    //   acmr: average cache miss ratio, vertices transformed per triangle (0.5 .. 3, lower is better)
+    //   atvr: average transform to vertex ratio, vertices transformed per vertex used (1 is the best)
+    //
+    struct VertexCacheStats {
+        uint32_t triangles;
+        uint32_t vertices; // vertices referenced by the indices
+        uint32_t transformed; // cache misses
+        float acmr;
+        float atvr;
+    };
+
+    // Triangle and vertex order optimization of the triangle list geometries.
+    //
+    //   optimizeVertexCache: triangle order for the post-transform vertex cache (Forsyth)
+    //   optimizeOverdraw: sorts the triangle clusters from the outside to the inside of the mesh,
+    //                     keeping the cache efficiency inside a threshold
+    //   optimizeVertexFetch: vertex order of the first use by the indices (memory prefetching)
+    //   weldVertices: merges the vertices equal in all attributes and bone weights
+    //
+    // The vertex order changes remap all vertex arrays (pos, normals, tangent, binormal,
+    // uv, color) and the bone weights vertexID.
+    //
+    // The triangle order passes change only the triangle lists (indiceCountPerFace == 3).
+    //
+    // Example:
+    //
+    //   model::VertexCacheStats before = model::GeometryOptimizer::analyzeVertexCache(geometry);
+    //
+    //   model::GeometryOptimizer::optimize(&geometry);
+    //
+    //   model::VertexCacheStats after = model::GeometryOptimizer::analyzeVertexCache(geometry);
+    //   printf("ACMR: %f -> %f ATVR: %f -> %f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+    //
+    class GeometryOptimizer {
+
+        // Forsyth scoring cache size (the real cache size does not need to match)
+        static const int ScoreCacheSize = 32;
+        static const int MaxValenceScore = 32;
+
+        static float cacheScore(int position) {
+            // the last triangle vertices get a fixed score, so the next triangle does not always reuse them
+            if (position < 0)
+                return 0.0f;
+            if (position < 3)
+                return 0.75f;
+            const float scaler = 1.0f / (float)(ScoreCacheSize - 3);
+            return powf(1.0f - (float)(position - 3) * scaler, 1.5f);
+        }
+
+        static float valenceScore(uint32_t valence) {
+            // vertices with few triangles left are finished first
+            return 2.0f * powf((float)valence, -0.5f);
+        }
+
+        static bool isTriangleList(const Geometry &geometry) {
+            return geometry.indiceCountPerFace == 3 && geometry.indice.size() % 3 == 0;
+        }
+
+        static uint32_t remapCount(const Geometry &geometry) {
+            uint32_t referenced = IndexBuffer_VertexCount(geometry.indice);
+            return (referenced > geometry.vertexCount) ? referenced : geometry.vertexCount;
+        }
+
+        template <typename T>
+        static void remapArray(aRibeiro::aligned_vector<T> *array, const std::vector<uint32_t> &newToOld) {
+            if (array->size() == 0)
+                return;
+            aRibeiro::aligned_vector<T> result;
+            result.resize(newToOld.size());
+            int count = (int)newToOld.size();
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) if (count > 65536)
+#endif
+            for (int i = 0; i < count; i++) {
+                // missing elements are zero
+                if (newToOld[i] < array->size())
+                    result[i] = (*array)[newToOld[i]];
+            }
+            array->swap(result);
+        }
+
+        static bool weightLess(const VertexWeight &a, const VertexWeight &b) {
+            return a.vertexID < b.vertexID;
+        }
+
+        struct Cluster {
+            uint32_t first;
+            uint32_t count;
+            float sortKey;
+        };
+
+        static bool clusterGreater(const Cluster &a, const Cluster &b) {
+            return a.sortKey > b.sortKey;
+        }
+
+        // the vertex attributes compared by the welding, as strided float arrays
+        struct WeldChannel {
+            const uint8_t *data;
+            size_t count;
+            size_t stride;
+            int components;
+        };
+
+        class WeldKey {
+        public:
+            // pos, normals, tangent, binormal: 3, uv[8]: 3, color[8]: 4
+            static const int MaxValues = 4 * 3 + 8 * 3 + 8 * 4;
+
+            std::vector<WeldChannel> channels;
+            int valueCount;
+            // the bone weights of each vertex: (bone, weight), sorted by bone
+            std::vector<uint32_t> weightOffset;
+            std::vector<uint32_t> weightBone;
+            std::vector<float> weightValue;
+            double invEpsilon;
+
+            template <typename T>
+            void addChannel(const aRibeiro::aligned_vector<T> &array, int components) {
+                if (array.size() == 0)
+                    return;
+                WeldChannel channel;
+                channel.data = (const uint8_t *)&array[0];
+                channel.count = array.size();
+                channel.stride = sizeof(T);
+                channel.components = components;
+                channels.push_back(channel);
+                valueCount += components;
+            }
+
+            // exact: the float bits (-0 is 0), epsilon: the grid cell of the value
+            uint64_t quantize(float value)const {
+                if (invEpsilon > 0.0) {
+                    double cell = floor((double)value * invEpsilon + 0.5);
+                    if (!(cell > -9.0e18))
+                        cell = -9.0e18;
+                    else if (cell > 9.0e18)
+                        cell = 9.0e18;
+                    return (uint64_t)(int64_t)cell;
+                }
+                if (value == 0.0f)
+                    return 0;
+                uint32_t bits;
+                memcpy(&bits, &value, sizeof(uint32_t));
+                return bits;
+            }
+
+            // the quantized attribute values of a vertex (valueCount)
+            void values(uint32_t v, uint64_t *out)const {
+                for (size_t i = 0; i < channels.size(); i++) {
+                    const WeldChannel &channel = channels[i];
+                    float f[4] = { 0, 0, 0, 0 };
+                    // missing elements are zero, constant size copies (vec3 or vec4)
+                    if (v < channel.count) {
+                        if (channel.components == 4)
+                            memcpy(f, channel.data + (size_t)v * channel.stride, 4 * sizeof(float));
+                        else
+                            memcpy(f, channel.data + (size_t)v * channel.stride, 3 * sizeof(float));
+                    }
+                    for (int c = 0; c < channel.components; c++)
+                        *out++ = quantize(f[c]);
+                }
+            }
+
+            static uint64_t mix(uint64_t hash, uint64_t v) {
+                hash ^= v;
+                hash *= 0x100000001b3ULL;
+                return hash ^ (hash >> 29);
+            }
+
+            uint32_t hash(uint32_t v)const {
+                uint64_t value[MaxValues];
+                values(v, value);
+                uint64_t h = 0xcbf29ce484222325ULL;
+                for (int i = 0; i < valueCount; i++)
+                    h = mix(h, value[i]);
+                for (uint32_t i = weightOffset[v]; i < weightOffset[v + 1]; i++) {
+                    h = mix(h, weightBone[i]);
+                    h = mix(h, quantize(weightValue[i]));
+                }
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                return (uint32_t)h;
+            }
+
+            bool equal(uint32_t a, uint32_t b)const {
+                uint64_t valueA[MaxValues];
+                uint64_t valueB[MaxValues];
+                values(a, valueA);
+                values(b, valueB);
+                if (memcmp(valueA, valueB, valueCount * sizeof(uint64_t)) != 0)
+                    return false;
+                return equalWeights(a, b);
+            }
+
+            bool equalWeights(uint32_t a, uint32_t b)const {
+                uint32_t countA = weightOffset[a + 1] - weightOffset[a];
+                if (countA != weightOffset[b + 1] - weightOffset[b])
+                    return false;
+                for (uint32_t i = 0; i < countA; i++) {
+                    if (weightBone[weightOffset[a] + i] != weightBone[weightOffset[b] + i] ||
+                        quantize(weightValue[weightOffset[a] + i]) != quantize(weightValue[weightOffset[b] + i]))
+                        return false;
+                }
+                return true;
+            }
+        };
+
+        // open addressing table of (vertex, hash) slots: the hash test does not touch the vertex arrays
+        static void weldInsert(const WeldKey &key, const std::vector<uint32_t> &hashes, uint32_t v, uint32_t *representative, uint32_t *table, uint32_t tableSize) {
+            const uint32_t empty = 0xffffffffu;
+            uint32_t hash = hashes[v];
+            uint32_t slot = hash & (tableSize - 1);
+            while (true) {
+                uint32_t candidate = table[slot * 2];
+                if (candidate == empty) {
+                    table[slot * 2] = v;
+                    table[slot * 2 + 1] = hash;
+                    representative[v] = v;
+                    return;
+                }
+                if (table[slot * 2 + 1] == hash && key.equal(candidate, v)) {
+                    representative[v] = candidate;
+                    return;
+                }
+                slot = (slot + 1) & (tableSize - 1);
+            }
+        }
+
+        static void weldRange(const WeldKey &key, const std::vector<uint32_t> &hashes, uint32_t first, uint32_t last, uint32_t *representative, uint32_t *table, uint32_t tableSize) {
+            for (uint32_t v = first; v < last; v++)
+                weldInsert(key, hashes, v, representative, table, tableSize);
+        }
+
+        static void weldList(const WeldKey &key, const std::vector<uint32_t> &hashes, const std::vector<uint32_t> &vertices, uint32_t *representative, uint32_t *table, uint32_t tableSize) {
+            for (size_t i = 0; i < vertices.size(); i++) {
+#if defined(ARIBEIRO_SSE2)
+                // the table is bigger than the cache: the slots of the next vertices are loaded ahead
+                if (i + 16 < vertices.size())
+                    _mm_prefetch((const char *)&table[(hashes[vertices[i + 16]] & (tableSize - 1)) * 2], _MM_HINT_T0);
+#endif
+                weldInsert(key, hashes, vertices[i], representative, table, tableSize);
+            }
+        }
+
+    public:
+
+        static VertexCacheStats analyzeVertexCache(const Geometry &geometry, uint32_t cacheSize = 16) {
+            VertexCacheStats stats;
+            stats.triangles = (uint32_t)(geometry.indice.size() / 3);
+            stats.vertices = 0;
+            stats.transformed = 0;
+
+            // FIFO: a vertex is in the cache while less than cacheSize misses happened after its own miss
+            std::vector<uint32_t> missTime(remapCount(geometry), 0);
+            uint32_t time = cacheSize + 1;
+            for (size_t i = 0; i < geometry.indice.size(); i++) {
+                uint32_t v = geometry.indice[i];
+                if (missTime[v] == 0)
+                    stats.vertices++;
+                if (time - missTime[v] > cacheSize) {
+                    missTime[v] = time++;
+                    stats.transformed++;
+                }
+            }
+
+            stats.acmr = (stats.triangles > 0) ? (float)stats.transformed / (float)stats.triangles : 0.0f;
+            stats.atvr = (stats.vertices > 0) ? (float)stats.transformed / (float)stats.vertices : 0.0f;
+            return stats;
+        }
+
+        // Forsyth: "Linear-Speed Vertex Cache Optimisation"
+        static void optimizeVertexCache(Geometry *geometry) {
+            if (!isTriangleList(*geometry) || geometry->indice.size() == 0)
+                return;
+
+            const std::vector<uint32_t> &indice = geometry->indice;
+            uint32_t vertexCount = remapCount(*geometry);
+            uint32_t triangleCount = (uint32_t)(indice.size() / 3);
+
+            float cacheScores[ScoreCacheSize];
+            for (int i = 0; i < ScoreCacheSize; i++)
+                cacheScores[i] = cacheScore(i);
+            float valenceScores[MaxValenceScore];
+            valenceScores[0] = 0.0f;
+            for (int i = 1; i < MaxValenceScore; i++)
+                valenceScores[i] = valenceScore(i);
+
+            // vertex -> triangles adjacency
+            std::vector<uint32_t> valence(vertexCount, 0);
+            for (size_t i = 0; i < indice.size(); i++)
+                valence[indice[i]]++;
+            std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+            for (uint32_t v = 0; v < vertexCount; v++)
+                adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+            std::vector<uint32_t> adjacency(indice.size());
+            {
+                std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+                for (size_t i = 0; i < indice.size(); i++)
+                    adjacency[fill[indice[i]]++] = (uint32_t)(i / 3);
+            }
+
+            // valence: the triangles not added yet
+            std::vector<int> cachePosition(vertexCount, -1);
+            std::vector<float> vertexScore(vertexCount);
+            for (uint32_t v = 0; v < vertexCount; v++)
+                vertexScore[v] = (valence[v] < MaxValenceScore) ? valenceScores[valence[v]] : valenceScore(valence[v]);
+
+            std::vector<float> triangleScore(triangleCount);
+            std::vector<uint8_t> added(triangleCount, 0);
+            for (uint32_t t = 0; t < triangleCount; t++)
+                triangleScore[t] = vertexScore[indice[t * 3]] + vertexScore[indice[t * 3 + 1]] + vertexScore[indice[t * 3 + 2]];
+
+            std::vector<uint32_t> result;
+            result.reserve(indice.size());
+
+            uint32_t cache[ScoreCacheSize + 3];
+            uint32_t cacheSize = 0;
+            uint32_t newCache[ScoreCacheSize + 3];
+
+            uint32_t cursor = 0; // next triangle not added, when the cache has no candidates
+            int best = -1;
+            float bestScore = -1.0f;
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+
+            for (uint32_t n = 0; n < triangleCount; n++) {
+                if (best < 0) {
+                    while (added[cursor])
+                        cursor++;
+                    best = (int)cursor;
+                }
+
+                uint32_t triangle = (uint32_t)best;
+                added[triangle] = 1;
+                const uint32_t *tri = &indice[triangle * 3];
+                result.push_back(tri[0]);
+                result.push_back(tri[1]);
+                result.push_back(tri[2]);
+
+                // the triangle vertices to the front of the cache
+                uint32_t newCacheSize = 0;
+                for (int i = 0; i < 3; i++) {
+                    uint32_t v = tri[i];
+                    valence[v]--;
+                    // remove the triangle from the vertex adjacency
+                    uint32_t *begin = &adjacency[adjacencyOffset[v]];
+                    uint32_t *end = begin + valence[v] + 1;
+                    for (uint32_t *it = begin; it != end; it++) {
+                        if (*it == triangle) {
+                            *it = *(end - 1);
+                            break;
+                        }
+                    }
+                    newCache[newCacheSize++] = v;
+                }
+                for (uint32_t i = 0; i < cacheSize; i++) {
+                    uint32_t v = cache[i];
+                    if (v != tri[0] && v != tri[1] && v != tri[2])
+                        newCache[newCacheSize++] = v;
+                }
+
+                // new vertex positions and scores, evicted vertices leave the cache
+                for (uint32_t i = 0; i < newCacheSize; i++) {
+                    uint32_t v = newCache[i];
+                    cachePosition[v] = (i < (uint32_t)ScoreCacheSize) ? (int)i : -1;
+                    float score = -1.0f;
+                    if (valence[v] > 0) {
+                        score = (cachePosition[v] >= 0) ? cacheScores[cachePosition[v]] : 0.0f;
+                        score += (valence[v] < MaxValenceScore) ? valenceScores[valence[v]] : valenceScore(valence[v]);
+                    }
+                    float delta = score - vertexScore[v];
+                    vertexScore[v] = score;
+                    for (uint32_t j = 0; j < valence[v]; j++)
+                        triangleScore[adjacency[adjacencyOffset[v] + j]] += delta;
+                }
+                cacheSize = (newCacheSize < (uint32_t)ScoreCacheSize) ? newCacheSize : (uint32_t)ScoreCacheSize;
+                for (uint32_t i = 0; i < cacheSize; i++)
+                    cache[i] = newCache[i];
+
+                // the next triangle: the best one using a vertex in the cache
+                best = -1;
+                bestScore = -1.0f;
+                for (uint32_t i = 0; i < cacheSize; i++) {
+                    uint32_t v = cache[i];
+                    for (uint32_t j = 0; j < valence[v]; j++) {
+                        uint32_t t = adjacency[adjacencyOffset[v] + j];
+                        if (triangleScore[t] > bestScore) {
+                            bestScore = triangleScore[t];
+                            best = (int)t;
+                        }
+                    }
+                }
+            }
+
+            geometry->indice.swap(result);
+        }
+
+        // Splits the triangle order in clusters at the cache restarts (triangles with 3 cache misses),
+        // and sorts the clusters by the direction they face from the mesh center:
+        // the outer clusters are drawn first and occlude the inner ones.
+        //
+        // threshold: the maximum ACMR increase allowed (1.05 = 5%), the order is kept when it is worse
+        static void optimizeOverdraw(Geometry *geometry, float threshold = 1.05f, uint32_t cacheSize = 16) {
+            if (!isTriangleList(*geometry) || geometry->indice.size() == 0)
+                return;
+
+            const std::vector<uint32_t> &indice = geometry->indice;
+            const aRibeiro::aligned_vector<aRibeiro::vec3> &pos = geometry->pos;
+            uint32_t triangleCount = (uint32_t)(indice.size() / 3);
+            for (size_t i = 0; i < indice.size(); i++)
+                if (indice[i] >= pos.size())
+                    return;
+
+            // clusters
+            std::vector<Cluster> clusters;
+            std::vector<uint32_t> missTime(remapCount(*geometry), 0);
+            uint32_t time = cacheSize + 1;
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                int misses = 0;
+                for (int i = 0; i < 3; i++) {
+                    uint32_t v = indice[t * 3 + i];
+                    if (time - missTime[v] > cacheSize) {
+                        missTime[v] = time++;
+                        misses++;
+                    }
+                }
+                if (misses == 3 || clusters.size() == 0) {
+                    Cluster cluster;
+                    cluster.first = t;
+                    cluster.count = 0;
+                    cluster.sortKey = 0.0f;
+                    clusters.push_back(cluster);
+                }
+                clusters.back().count++;
+            }
+            if (clusters.size() < 2)
+                return;
+
+            // area weighted mesh center
+            aRibeiro::vec3 meshCenter(0, 0, 0);
+            float meshArea = 0.0f;
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                const aRibeiro::vec3 &a = pos[indice[t * 3]];
+                const aRibeiro::vec3 &b = pos[indice[t * 3 + 1]];
+                const aRibeiro::vec3 &c = pos[indice[t * 3 + 2]];
+                float area = aRibeiro::length(aRibeiro::cross(b - a, c - a));
+                meshCenter += (a + b + c) * (area / 3.0f);
+                meshArea += area;
+            }
+            if (meshArea > 0.0f)
+                meshCenter = meshCenter * (1.0f / meshArea);
+
+            for (size_t k = 0; k < clusters.size(); k++) {
+                Cluster &cluster = clusters[k];
+                aRibeiro::vec3 center(0, 0, 0);
+                aRibeiro::vec3 normal(0, 0, 0);
+                float area = 0.0f;
+                for (uint32_t t = cluster.first; t < cluster.first + cluster.count; t++) {
+                    const aRibeiro::vec3 &a = pos[indice[t * 3]];
+                    const aRibeiro::vec3 &b = pos[indice[t * 3 + 1]];
+                    const aRibeiro::vec3 &c = pos[indice[t * 3 + 2]];
+                    // the cross product length is two times the area
+                    aRibeiro::vec3 n = aRibeiro::cross(b - a, c - a);
+                    float triangleArea = aRibeiro::length(n);
+                    center += (a + b + c) * (triangleArea / 3.0f);
+                    normal += n;
+                    area += triangleArea;
+                }
+                float normalLength = aRibeiro::length(normal);
+                if (area <= 0.0f || normalLength <= 0.0f)
+                    continue;
+                center = center * (1.0f / area);
+                cluster.sortKey = aRibeiro::dot(center - meshCenter, normal * (1.0f / normalLength));
+            }
+
+            std::stable_sort(clusters.begin(), clusters.end(), clusterGreater);
+
+            std::vector<uint32_t> result;
+            result.reserve(indice.size());
+            for (size_t k = 0; k < clusters.size(); k++)
+                result.insert(result.end(), indice.begin() + clusters[k].first * 3, indice.begin() + (clusters[k].first + clusters[k].count) * 3);
+
+            float acmrBefore = analyzeVertexCache(*geometry, cacheSize).acmr;
+            geometry->indice.swap(result);
+            float acmrAfter = analyzeVertexCache(*geometry, cacheSize).acmr;
+            if (acmrAfter > acmrBefore * threshold)
+                geometry->indice.swap(result);
+        }
+
+        // the vertices in the order of the first use by the indices (the unused vertices at the end)
+        static void optimizeVertexFetch(Geometry *geometry) {
+            uint32_t vertexCount = remapCount(*geometry);
+            if (vertexCount == 0)
+                return;
+
+            const uint32_t unused = 0xffffffffu;
+            std::vector<uint32_t> oldToNew(vertexCount, unused);
+            std::vector<uint32_t> newToOld;
+            newToOld.reserve(vertexCount);
+            for (size_t i = 0; i < geometry->indice.size(); i++) {
+                uint32_t v = geometry->indice[i];
+                if (oldToNew[v] == unused) {
+                    oldToNew[v] = (uint32_t)newToOld.size();
+                    newToOld.push_back(v);
+                }
+                geometry->indice[i] = oldToNew[v];
+            }
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                if (oldToNew[v] == unused) {
+                    oldToNew[v] = (uint32_t)newToOld.size();
+                    newToOld.push_back(v);
+                }
+            }
+
+            remapArray(&geometry->pos, newToOld);
+            remapArray(&geometry->normals, newToOld);
+            remapArray(&geometry->tangent, newToOld);
+            remapArray(&geometry->binormal, newToOld);
+            for (int i = 0; i < 8; i++) {
+                remapArray(&geometry->uv[i], newToOld);
+                remapArray(&geometry->color[i], newToOld);
+            }
+
+            for (size_t b = 0; b < geometry->bones.size(); b++) {
+                aRibeiro::aligned_vector<VertexWeight> &weights = geometry->bones[b].weights;
+                for (size_t i = 0; i < weights.size(); i++)
+                    if (weights[i].vertexID < vertexCount)
+                        weights[i].vertexID = oldToNew[weights[i].vertexID];
+                // sorted ids keep the delta coding of the weights small
+                std::stable_sort(weights.begin(), weights.end(), weightLess);
+            }
+
+            geometry->vertexCount = vertexCount;
+        }
+
+        // Merges the vertices with the same values in all vertex arrays (pos, normals, tangent,
+        // binormal, uv, color) and the same bone weights. Rebuilds the indices (a geometry
+        // without indices gets them), compacts the arrays and the bone weights.
+        //
+        // epsilon: 0 compares the exact values, > 0 merges the values in the same epsilon grid cell
+        //
+        // The hashes and the merge run in parallel (OpenMP): each block of vertices is merged with
+        // its own hash table, and the block results are merged after that.
+        //
+        // returns the vertex count after the welding
+        static uint32_t weldVertices(Geometry *geometry, float epsilon = 0.0f) {
+            uint32_t vertexCount = remapCount(*geometry);
+            if (vertexCount == 0)
+                return 0;
+
+            WeldKey key;
+            key.valueCount = 0;
+            key.invEpsilon = (epsilon > 0.0f) ? 1.0 / (double)epsilon : 0.0;
+            key.addChannel(geometry->pos, 3);
+            key.addChannel(geometry->normals, 3);
+            key.addChannel(geometry->tangent, 3);
+            key.addChannel(geometry->binormal, 3);
+            for (int i = 0; i < 8; i++) {
+                key.addChannel(geometry->uv[i], 3);
+                key.addChannel(geometry->color[i], 4);
+            }
+
+            // the weights of each vertex, in the bones order
+            key.weightOffset.assign(vertexCount + 1, 0);
+            for (size_t b = 0; b < geometry->bones.size(); b++) {
+                const aRibeiro::aligned_vector<VertexWeight> &weights = geometry->bones[b].weights;
+                for (size_t i = 0; i < weights.size(); i++)
+                    if (weights[i].vertexID < vertexCount)
+                        key.weightOffset[weights[i].vertexID + 1]++;
+            }
+            for (uint32_t v = 0; v < vertexCount; v++)
+                key.weightOffset[v + 1] += key.weightOffset[v];
+            key.weightBone.resize(key.weightOffset[vertexCount]);
+            key.weightValue.resize(key.weightOffset[vertexCount]);
+            {
+                std::vector<uint32_t> fill(key.weightOffset.begin(), key.weightOffset.end() - 1);
+                for (size_t b = 0; b < geometry->bones.size(); b++) {
+                    const aRibeiro::aligned_vector<VertexWeight> &weights = geometry->bones[b].weights;
+                    for (size_t i = 0; i < weights.size(); i++) {
+                        uint32_t v = weights[i].vertexID;
+                        if (v >= vertexCount)
+                            continue;
+                        key.weightBone[fill[v]] = (uint32_t)b;
+                        key.weightValue[fill[v]] = weights[i].weight;
+                        fill[v]++;
+                    }
+                }
+            }
+
+            int count = (int)vertexCount;
+            std::vector<uint32_t> hashes(vertexCount);
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) if (count > 65536)
+#endif
+            for (int v = 0; v < count; v++)
+                hashes[v] = key.hash((uint32_t)v);
+
+            // 1) each block of vertices is welded in parallel with its own hash table:
+            //    the duplicates are usually close (the same or the next triangles), and the block
+            //    vertices and table stay in the cache
+            const uint32_t empty = 0xffffffffu;
+            const int blockSize = 1 << 16;
+            int blockCount = (int)((vertexCount + blockSize - 1) / blockSize);
+            std::vector<uint32_t> representative(vertexCount);
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(dynamic) if (blockCount > 1)
+#endif
+            for (int block = 0; block < blockCount; block++) {
+                uint32_t first = (uint32_t)block * blockSize;
+                uint32_t last = (first + blockSize < vertexCount) ? first + blockSize : vertexCount;
+                std::vector<uint32_t> table(blockSize * 2 * 2, empty);
+                weldRange(key, hashes, first, last, &representative[0], &table[0], blockSize * 2);
+            }
+
+            // 2) the block representatives are welded between the blocks (in the vertex order)
+            std::vector<uint32_t> blockRepresentatives;
+            for (uint32_t v = 0; v < vertexCount; v++)
+                if (representative[v] == v)
+                    blockRepresentatives.push_back(v);
+            if (blockCount > 1) {
+                uint32_t tableSize = 16;
+                while (tableSize < blockRepresentatives.size() * 2)
+                    tableSize <<= 1;
+                std::vector<uint32_t> table((size_t)tableSize * 2, empty);
+                weldList(key, hashes, blockRepresentatives, &representative[0], &table[0], tableSize);
+                // the vertices merged in the block follow their block representative
+                for (uint32_t v = 0; v < vertexCount; v++)
+                    representative[v] = representative[representative[v]];
+            }
+
+            // new indices in the original vertex order
+            std::vector<uint32_t> oldToNew(vertexCount);
+            std::vector<uint32_t> newToOld;
+            newToOld.reserve(vertexCount);
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                if (representative[v] == v) {
+                    oldToNew[v] = (uint32_t)newToOld.size();
+                    newToOld.push_back(v);
+                } else
+                    oldToNew[v] = oldToNew[representative[v]];
+            }
+
+            if (geometry->indice.size() == 0) {
+                geometry->indice.assign(oldToNew.begin(), oldToNew.end());
+            } else {
+                int indiceCount = (int)geometry->indice.size();
+#if defined(_OPENMP)
+                #pragma omp parallel for schedule(static) if (indiceCount > 65536)
+#endif
+                for (int i = 0; i < indiceCount; i++)
+                    geometry->indice[i] = oldToNew[geometry->indice[i]];
+            }
+
+            remapArray(&geometry->pos, newToOld);
+            remapArray(&geometry->normals, newToOld);
+            remapArray(&geometry->tangent, newToOld);
+            remapArray(&geometry->binormal, newToOld);
+            for (int i = 0; i < 8; i++) {
+                remapArray(&geometry->uv[i], newToOld);
+                remapArray(&geometry->color[i], newToOld);
+            }
+
+            // the merged vertices have the same weights: only the representative weights are kept
+            for (size_t b = 0; b < geometry->bones.size(); b++) {
+                aRibeiro::aligned_vector<VertexWeight> &weights = geometry->bones[b].weights;
+                size_t kept = 0;
+                for (size_t i = 0; i < weights.size(); i++) {
+                    uint32_t v = weights[i].vertexID;
+                    if (v >= vertexCount || representative[v] != v)
+                        continue;
+                    weights[kept] = weights[i];
+                    weights[kept].vertexID = oldToNew[v];
+                    kept++;
+                }
+                weights.resize(kept);
+            }
+
+            geometry->vertexCount = (uint32_t)newToOld.size();
+            return geometry->vertexCount;
+        }
+
+        // vertex cache, overdraw (optional) and vertex fetch
+        static void optimize(Geometry *geometry, bool overdraw = true) {
+            if (!isTriangleList(*geometry))
+                return;
+            optimizeVertexCache(geometry);
+            if (overdraw)
+                optimizeOverdraw(geometry);
+            optimizeVertexFetch(geometry);
+        }
+
+    };
+
+}
+
+#endif
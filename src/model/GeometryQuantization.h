@@ -0,0 +1,403 @@
+#ifndef model_geometry_quantization_h_
+#define model_geometry_quantization_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <vector>
+#include <string.h> // memcpy
+#include <math.h>
+
+namespace model {
+
+    // Attribute quantization of the geometry stream (ModelRevision_Quantized).
+    //
+    // The geometry arrays are 32 bits floats. The quantized stream stores:
+    //
+    //   GeometryQuantize_Pos16: position as 3 x uint16 inside the geometry bounds (AABB)
+    //   GeometryQuantize_NormalOct16: normal, tangent and binormal as 2 x int16 octahedral (unit vectors)
+    //   GeometryQuantize_UVHalf: uv as 2 half floats
+    //   GeometryQuantize_ColorUNorm8: color as 4 unsigned bytes
+    //
+    // A vertex with position, normal, tangent, uv and color goes from 60 bytes to 22 bytes.
+    //
+    // The quantization is lossy: the position error is (max - min) / 131070 in each axis,
+    // the normals are normalized on the read, and the uv have the half float precision.
+    //
+    // The packed arrays keep two 16 bits values or four bytes in each uint32_t (the first
+    // value in the low bits), so in a little endian host they can be uploaded to the GPU as they are:
+    //
+    //   pos: GL_UNSIGNED_SHORT x 3, normalized (pos = boundsMin + value * (boundsMax - boundsMin))
+    //   normals: GL_SHORT x 2, normalized (octahedral decode in the shader)
+    //   uv: GL_HALF_FLOAT x 2
+    //   color: GL_UNSIGNED_BYTE x 4, normalized
+    //
+
+    const uint32_t GeometryQuantize_None = 0;
+    const uint32_t GeometryQuantize_Pos16 = (1 << 0);
+    const uint32_t GeometryQuantize_NormalOct16 = (1 << 1);
+    const uint32_t GeometryQuantize_UVHalf = (1 << 2);
+    const uint32_t GeometryQuantize_ColorUNorm8 = (1 << 3);
+    const uint32_t GeometryQuantize_All = GeometryQuantize_Pos16 | GeometryQuantize_NormalOct16 | GeometryQuantize_UVHalf | GeometryQuantize_ColorUNorm8;
+
+    // the quantized attributes in the stream layout
+    class _SSE2_ALIGN_PRE GeometryQuantized {
+    public:
+        aRibeiro::vec3 boundsMin;
+        aRibeiro::vec3 boundsMax;
+
+        std::vector<uint16_t> pos; // x, y, z
+        std::vector<uint32_t> normals; // octahedral x | y << 16
+        std::vector<uint32_t> tangent;
+        std::vector<uint32_t> binormal;
+        std::vector<uint32_t> uv[8]; // half u | half v << 16
+        std::vector<uint32_t> color[8]; // r | g << 8 | b << 16 | a << 24
+
+        // the arrays keep their memory
+        void clear() {
+            boundsMin = aRibeiro::vec3(0);
+            boundsMax = aRibeiro::vec3(0);
+            pos.clear();
+            normals.clear();
+            tangent.clear();
+            binormal.clear();
+            for (int i = 0; i < 8; i++) {
+                uv[i].clear();
+                color[i].clear();
+            }
+        }
+
+        SSE2_CLASS_NEW_OPERATOR
+    }_SSE2_ALIGN_POS;
+
+    class GeometryQuantization {
+
+        static float snorm16(uint32_t value) {
+            float result = (float)(int16_t)(uint16_t)value * (1.0f / 32767.0f);
+            return (result < -1.0f) ? -1.0f : result;
+        }
+
+    public:
+
+#if defined(ARIBEIRO_SSE2)
+        // xyz of a lane to a vec3 (the SSE2 vec3 is padded to 16 bytes)
+        static void storeVec3(aRibeiro::vec3 *out, __m128 v) {
+            if (sizeof(aRibeiro::vec3) == 16)
+                _mm_storeu_ps((float *)out, v);
+            else {
+                float f[4];
+                _mm_storeu_ps(f, v);
+                out->x = f[0];
+                out->y = f[1];
+                out->z = f[2];
+            }
+        }
+#endif
+
+        // round to nearest even, overflow to infinity
+        static uint16_t floatToHalf(float value) {
+            uint32_t f;
+            memcpy(&f, &value, sizeof(uint32_t));
+            uint32_t sign = f & 0x80000000u;
+            f ^= sign;
+            uint32_t result;
+            if (f >= 0x47800000u) {
+                // inf, nan or too big
+                result = (f > 0x7f800000u) ? 0x7e00 : 0x7c00;
+            } else if (f < 0x38800000u) {
+                // subnormal or zero: the float addition rounds the mantissa
+                const uint32_t magicBits = 0x3f000000u;
+                float magic, sum;
+                memcpy(&magic, &magicBits, sizeof(float));
+                memcpy(&sum, &f, sizeof(float));
+                sum += magic;
+                memcpy(&f, &sum, sizeof(float));
+                result = f - magicBits;
+            } else {
+                uint32_t mantissaOdd = (f >> 13) & 1;
+                f += 0xc8000fffu; // rebias the exponent and round
+                f += mantissaOdd;
+                result = f >> 13;
+            }
+            return (uint16_t)(result | (sign >> 16));
+        }
+
+        static float halfToFloat(uint16_t value) {
+            uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+            uint32_t exponent = (value >> 10) & 0x1f;
+            uint32_t mantissa = value & 0x3ff;
+            uint32_t bits;
+            if (exponent == 0x1f)
+                bits = sign | 0x7f800000u | (mantissa << 13);
+            else if (exponent != 0)
+                bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+            else {
+                float result = (float)mantissa * (1.0f / 16777216.0f);
+                return (sign) ? -result : result;
+            }
+            float result;
+            memcpy(&result, &bits, sizeof(float));
+            return result;
+        }
+
+        // clamp to [min..1] and round to the nearest integer of the scale
+        static int32_t floatToNorm(float value, float min, float scale) {
+            if (!(value > min))
+                value = min;
+            else if (value > 1.0f)
+                value = 1.0f;
+            return (int32_t)floorf(value * scale + 0.5f);
+        }
+
+#if defined(ARIBEIRO_SSE2)
+        // 4 floats to 4 halfs (in the low 16 bits of each lane, sign extended)
+        static __m128i floatToHalf4(__m128 value) {
+            __m128 sign = _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(0x80000000u)));
+            __m128 absf = _mm_xor_ps(value, sign);
+            __m128i absi = _mm_castps_si128(absf);
+
+            __m128 isNaN = _mm_cmpunord_ps(absf, absf);
+            __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(0x47800000), absi);
+            __m128i infOrNaN = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNaN), _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+            // subnormal: the float addition rounds the mantissa
+            __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(0x38800000), absi);
+            __m128 subnormal1 = _mm_add_ps(absf, _mm_castsi128_ps(_mm_set1_epi32(0x3f000000)));
+            __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(subnormal1), _mm_set1_epi32(0x3f000000));
+
+            // normal: rebias the exponent and round to nearest even
+            __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absi, 31 - 13), 31);
+            __m128i rounded = _mm_sub_epi32(_mm_add_epi32(absi, _mm_set1_epi32((int)0xc8000fffu)), mantissaOdd);
+            __m128i normal = _mm_srli_epi32(rounded, 13);
+
+            __m128i finite = _mm_or_si128(_mm_and_si128(subnormal, isSubnormal), _mm_andnot_si128(isSubnormal, normal));
+            __m128i result = _mm_or_si128(_mm_and_si128(finite, isRegular), _mm_andnot_si128(isRegular, infOrNaN));
+            return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+        }
+
+        // 4 halfs (in the low 16 bits of each lane) to 4 floats
+        static __m128 halfToFloat4(__m128i value) {
+            __m128i sign = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x8000)), 16);
+            __m128i shifted = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x7fff)), 13);
+            __m128i exponent = _mm_and_si128(shifted, _mm_set1_epi32(0x0f800000));
+
+            // rebias the exponent, twice for inf and nan
+            shifted = _mm_add_epi32(shifted, _mm_set1_epi32(112 << 23));
+            __m128i isInfNaN = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x0f800000));
+            shifted = _mm_add_epi32(shifted, _mm_and_si128(isInfNaN, _mm_set1_epi32(112 << 23)));
+
+            // zero and subnormal: renormalized by the float subtraction
+            __m128i isSubnormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+            __m128 subnormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(shifted, _mm_set1_epi32(1 << 23))),
+                                          _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+
+            __m128i result = _mm_or_si128(_mm_and_si128(isSubnormal, _mm_castps_si128(subnormal)), _mm_andnot_si128(isSubnormal, shifted));
+            return _mm_castsi128_ps(_mm_or_si128(result, sign));
+        }
+#endif
+
+        static void bounds(const aRibeiro::aligned_vector<aRibeiro::vec3> &pos, aRibeiro::vec3 *min, aRibeiro::vec3 *max) {
+            if (pos.size() == 0) {
+                *min = *max = aRibeiro::vec3(0);
+                return;
+            }
+            *min = *max = pos[0];
+            for (size_t i = 1; i < pos.size(); i++) {
+                *min = aRibeiro::minimum(*min, pos[i]);
+                *max = aRibeiro::maximum(*max, pos[i]);
+            }
+        }
+
+        //
+        // position: 3 x uint16 inside the bounds
+        //
+        static void encodePos(const aRibeiro::aligned_vector<aRibeiro::vec3> &pos, const aRibeiro::vec3 &min, const aRibeiro::vec3 &max, std::vector<uint16_t> *output) {
+            output->resize(pos.size() * 3);
+            aRibeiro::vec3 extent = max - min;
+            float scale[3];
+            for (int c = 0; c < 3; c++)
+                scale[c] = (extent[c] > 0.0f) ? 65535.0f / extent[c] : 0.0f;
+            for (size_t i = 0; i < pos.size(); i++) {
+                for (int c = 0; c < 3; c++) {
+                    float q = floorf((pos[i][c] - min[c]) * scale[c] + 0.5f);
+                    (*output)[i * 3 + c] = (uint16_t)((q > 0.0f) ? ((q < 65535.0f) ? q : 65535.0f) : 0.0f);
+                }
+            }
+        }
+
+        static void decodePos(const std::vector<uint16_t> &input, const aRibeiro::vec3 &min, const aRibeiro::vec3 &max, aRibeiro::aligned_vector<aRibeiro::vec3> *output) {
+            size_t count = input.size() / 3;
+            output->resize(count);
+            if (count == 0)
+                return;
+            aRibeiro::vec3 scale = (max - min) * (1.0f / 65535.0f);
+            const uint16_t *in = &input[0];
+            aRibeiro::vec3 *out = &(*output)[0];
+#if defined(ARIBEIRO_SSE2)
+            __m128 vscale = _mm_setr_ps(scale.x, scale.y, scale.z, 0.0f);
+            __m128 vmin = _mm_setr_ps(min.x, min.y, min.z, 0.0f);
+            for (size_t i = 0; i < count; i++, in += 3) {
+                __m128i q = _mm_setr_epi32(in[0], in[1], in[2], 0);
+                storeVec3(&out[i], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(q), vscale), vmin));
+            }
+#else
+            for (size_t i = 0; i < count; i++, in += 3)
+                out[i] = aRibeiro::vec3(min.x + (float)in[0] * scale.x,
+                                        min.y + (float)in[1] * scale.y,
+                                        min.z + (float)in[2] * scale.z);
+#endif
+        }
+
+        //
+        // unit vector: octahedral 2 x int16
+        //
+        static uint32_t octEncode(const aRibeiro::vec3 &v) {
+            float l1 = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+            if (!(l1 > 0.0f))
+                return 0;
+            float x = v.x / l1;
+            float y = v.y / l1;
+            if (v.z < 0.0f) {
+                // lower hemisphere folded over the diagonals
+                float fx = (1.0f - fabsf(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+                float fy = (1.0f - fabsf(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+                x = fx;
+                y = fy;
+            }
+            uint32_t qx = (uint16_t)(int16_t)floatToNorm(x, -1.0f, 32767.0f);
+            uint32_t qy = (uint16_t)(int16_t)floatToNorm(y, -1.0f, 32767.0f);
+            return qx | (qy << 16);
+        }
+
+        static aRibeiro::vec3 octDecode(uint32_t value) {
+            float x = snorm16(value & 0xffff);
+            float y = snorm16(value >> 16);
+            float z = 1.0f - fabsf(x) - fabsf(y);
+            float t = (z < 0.0f) ? -z : 0.0f;
+            x += (x >= 0.0f) ? -t : t;
+            y += (y >= 0.0f) ? -t : t;
+            float inv = 1.0f / sqrtf(x * x + y * y + z * z);
+            return aRibeiro::vec3(x * inv, y * inv, z * inv);
+        }
+
+        static void encodeOct(const aRibeiro::aligned_vector<aRibeiro::vec3> &input, std::vector<uint32_t> *output) {
+            output->resize(input.size());
+            for (size_t i = 0; i < input.size(); i++)
+                (*output)[i] = octEncode(input[i]);
+        }
+
+        static void decodeOct(const std::vector<uint32_t> &input, aRibeiro::aligned_vector<aRibeiro::vec3> *output) {
+            output->resize(input.size());
+            if (input.size() == 0)
+                return;
+            const uint32_t *in = &input[0];
+            aRibeiro::vec3 *out = &(*output)[0];
+            size_t i = 0;
+#if defined(ARIBEIRO_SSE2)
+            // 4 vectors at a time: x, y and z of 4 vectors in each register
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 minusOne = _mm_set1_ps(-1.0f);
+            const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000u));
+            const __m128 snorm = _mm_set1_ps(1.0f / 32767.0f);
+            for (; i + 4 <= input.size(); i += 4) {
+                __m128i packed = _mm_loadu_si128((const __m128i *)(in + i));
+                __m128 x = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 16), 16)), snorm), minusOne);
+                __m128 y = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(packed, 16)), snorm), minusOne);
+                __m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+                __m128 t = _mm_max_ps(_mm_xor_ps(z, signMask), _mm_setzero_ps());
+                // x >= 0 ? x - t : x + t
+                x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(x, signMask)));
+                y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(y, signMask)));
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+                __m128 inv = _mm_div_ps(one, length);
+                x = _mm_mul_ps(x, inv);
+                y = _mm_mul_ps(y, inv);
+                z = _mm_mul_ps(z, inv);
+                __m128 w = _mm_setzero_ps();
+                _MM_TRANSPOSE4_PS(x, y, z, w);
+                storeVec3(&out[i], x);
+                storeVec3(&out[i + 1], y);
+                storeVec3(&out[i + 2], z);
+                storeVec3(&out[i + 3], w);
+            }
+#endif
+            for (; i < input.size(); i++)
+                out[i] = octDecode(in[i]);
+        }
+
+        //
+        // uv: 2 half floats
+        //
+        static void encodeHalf2(const aRibeiro::aligned_vector<aRibeiro::vec3> &input, std::vector<uint32_t> *output) {
+            output->resize(input.size());
+            for (size_t i = 0; i < input.size(); i++)
+                (*output)[i] = (uint32_t)floatToHalf(input[i].x) | ((uint32_t)floatToHalf(input[i].y) << 16);
+        }
+
+        static void decodeHalf2(const std::vector<uint32_t> &input, aRibeiro::aligned_vector<aRibeiro::vec3> *output) {
+            output->resize(input.size());
+            if (input.size() == 0)
+                return;
+            const uint32_t *in = &input[0];
+            aRibeiro::vec3 *out = &(*output)[0];
+            size_t i = 0;
+#if defined(ARIBEIRO_SSE2)
+            for (; i + 4 <= input.size(); i += 4) {
+                __m128i packed = _mm_loadu_si128((const __m128i *)(in + i));
+                __m128 u = halfToFloat4(_mm_and_si128(packed, _mm_set1_epi32(0xffff)));
+                __m128 v = halfToFloat4(_mm_srli_epi32(packed, 16));
+                __m128 z = _mm_setzero_ps();
+                __m128 w = _mm_setzero_ps();
+                _MM_TRANSPOSE4_PS(u, v, z, w);
+                storeVec3(&out[i], u);
+                storeVec3(&out[i + 1], v);
+                storeVec3(&out[i + 2], z);
+                storeVec3(&out[i + 3], w);
+            }
+#endif
+            for (; i < input.size(); i++)
+                out[i] = aRibeiro::vec3(halfToFloat((uint16_t)in[i]), halfToFloat((uint16_t)(in[i] >> 16)), 0.0f);
+        }
+
+        //
+        // color: 4 unsigned bytes
+        //
+        static void encodeUNorm8(const aRibeiro::aligned_vector<aRibeiro::vec4> &input, std::vector<uint32_t> *output) {
+            output->resize(input.size());
+            for (size_t i = 0; i < input.size(); i++) {
+                uint32_t rgba = 0;
+                for (int c = 0; c < 4; c++)
+                    rgba |= (uint32_t)floatToNorm(input[i][c], 0.0f, 255.0f) << (c * 8);
+                (*output)[i] = rgba;
+            }
+        }
+
+        static void decodeUNorm8(const std::vector<uint32_t> &input, aRibeiro::aligned_vector<aRibeiro::vec4> *output) {
+            output->resize(input.size());
+            if (input.size() == 0)
+                return;
+            const uint32_t *in = &input[0];
+            aRibeiro::vec4 *out = &(*output)[0];
+            size_t i = 0;
+#if defined(ARIBEIRO_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 unorm = _mm_set1_ps(1.0f / 255.0f);
+            for (; i + 4 <= input.size(); i += 4) {
+                __m128i packed = _mm_loadu_si128((const __m128i *)(in + i));
+                __m128i lo = _mm_unpacklo_epi8(packed, zero);
+                __m128i hi = _mm_unpackhi_epi8(packed, zero);
+                _mm_storeu_ps((float *)&out[i], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), unorm));
+                _mm_storeu_ps((float *)&out[i + 1], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), unorm));
+                _mm_storeu_ps((float *)&out[i + 2], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), unorm));
+                _mm_storeu_ps((float *)&out[i + 3], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), unorm));
+            }
+#endif
+            for (; i < input.size(); i++) {
+                uint32_t rgba = in[i];
+                out[i] = aRibeiro::vec4((float)(rgba & 0xff), (float)((rgba >> 8) & 0xff), (float)((rgba >> 16) & 0xff), (float)(rgba >> 24)) * (1.0f / 255.0f);
+            }
+        }
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,431 @@
+#ifndef model_geometry_view_h_
+#define model_geometry_view_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <aRibeiroData/BinaryWriter.h>
+#include <aRibeiroData/BinaryEndian.h>
+#include <vector>
+#include <map>
+#include <string.h> // memcpy
+
+#include "Geometry.h"
+#include "ModelFields.h"
+#include "IndexBuffer.h"
+
+namespace model {
+
+    // Flat layout of the geometry attributes, read in place.
+    //
+    // The Geometry::read parses each attribute to an aligned_vector. The GeometryView
+    // keeps typed pointers straight into the reader memory (the mapped file, or the
+    // inflated buffer): loading a mesh costs a pointer fix-up, not a parse.
+    //
+    // Stream layout:
+    //
+    //   name | uint32 format | uint32 vertexCount | uint32 indiceCountPerFace | uint32 materialIndex
+    //   21 x uint32 count: pos, normals, tangent, binormal, uv[8], color[8], indice
+    //   uint32 index size: 1, 2 or 4 bytes (the smallest width for the indices)
+    //   padding to 16 bytes
+    //   data: each array starts at a 16 bytes offset (vec3 and vec4 use 16 bytes, the indices the index size)
+    //   bones
+    //
+    // The pointers are valid while the reader memory is valid (until the reader is closed or opened again).
+    //
+    // The arrays are copied to the view memory only when they cannot be used in place:
+    // in the streaming mode, in big endian hosts, when the vec3 has no SSE2 padding,
+    // or when the reader memory is not 16 bytes aligned.
+    //
+    // Example:
+    //
+    //   aRibeiro::BinaryReader reader;
+    //   reader.readFromFileMapped("mesh.bin");
+    //
+    //   model::GeometryView view;
+    //   view.read(&reader);
+    //
+    //   glBufferData(GL_ARRAY_BUFFER, view.vertexCount * sizeof(aRibeiro::vec3), view.pos, GL_STATIC_DRAW);
+    //   glBufferData(GL_ELEMENT_ARRAY_BUFFER, view.indiceCount * view.indiceSize, view.indice, GL_STATIC_DRAW);
+    //   ...
+    //   reader.close();
+    //
+    class _SSE2_ALIGN_PRE GeometryView {
+
+        // the arrays copied from the reader, when they cannot be used in place
+        aRibeiro::aligned_vector<aRibeiro::vec4> storage;
+
+        enum AttributeType {
+            AttributeType_Vec3 = 0,
+            AttributeType_Vec4 = 1,
+            AttributeType_Index = 2
+        };
+
+        static const int AttributeCount = 21;
+
+        // the attributes in the stream order
+        void attribute(int i, const void ***pointer, uint32_t **count, AttributeType *type) {
+            if (i < 4) {
+                const aRibeiro::vec3 **vec3Pointer[4] = { &pos, &normals, &tangent, &binormal };
+                uint32_t *vec3Count[4] = { &posCount, &normalsCount, &tangentCount, &binormalCount };
+                *pointer = (const void **)vec3Pointer[i];
+                *count = vec3Count[i];
+                *type = AttributeType_Vec3;
+            } else if (i < 12) {
+                *pointer = (const void **)&uv[i - 4];
+                *count = &uvCount[i - 4];
+                *type = AttributeType_Vec3;
+            } else if (i < 20) {
+                *pointer = (const void **)&color[i - 12];
+                *count = &colorCount[i - 12];
+                *type = AttributeType_Vec4;
+            } else {
+                *pointer = (const void **)&indice;
+                *count = &indiceCount;
+                *type = AttributeType_Index;
+            }
+        }
+
+        static size_t streamSize(AttributeType type, size_t indexSize) {
+            return (type == AttributeType_Index) ? indexSize : 16;
+        }
+
+        static size_t memorySize(AttributeType type, size_t indexSize) {
+            if (type == AttributeType_Vec3)
+                return sizeof(aRibeiro::vec3);
+            if (type == AttributeType_Vec4)
+                return sizeof(aRibeiro::vec4);
+            return indexSize;
+        }
+
+        static void setIndex(uint8_t *item, size_t indexSize, uint32_t v) {
+            if (indexSize == 1) {
+                item[0] = (uint8_t)v;
+            } else if (indexSize == 2) {
+                uint16_t v16 = (uint16_t)v;
+                memcpy(item, &v16, sizeof(uint16_t));
+            } else
+                memcpy(item, &v, sizeof(uint32_t));
+        }
+
+        static size_t align16(size_t size) {
+            return (size + 15) & ~(size_t)15;
+        }
+
+        // the stream layout is the memory layout: little endian and vec3 with the SSE2 padding
+        static bool inPlaceLayout() {
+            return !ARIBEIRO_BINARY_BIG_ENDIAN && sizeof(aRibeiro::vec3) == 16 && sizeof(aRibeiro::vec4) == 16;
+        }
+
+    public:
+        std::string name;
+
+        //VertexFormat: CONTAINS_POS | CONTAINS_NORMAL | ...
+        uint32_t format;
+        uint32_t vertexCount;
+        uint32_t indiceCountPerFace;// 1 - points, 2 - lines, 3 - triangles, 4 - quads
+        uint32_t materialIndex;
+
+        const aRibeiro::vec3 *pos;
+        const aRibeiro::vec3 *normals;
+        const aRibeiro::vec3 *tangent;
+        const aRibeiro::vec3 *binormal;
+        const aRibeiro::vec3 *uv[8];
+        const aRibeiro::vec4 *color[8];//RGBA
+        const void *indice;
+        uint32_t indiceSize; // bytes of each index: 1, 2 or 4
+
+        uint32_t posCount;
+        uint32_t normalsCount;
+        uint32_t tangentCount;
+        uint32_t binormalCount;
+        uint32_t uvCount[8];
+        uint32_t colorCount[8];
+        uint32_t indiceCount;
+
+        aRibeiro::aligned_vector<Bone> bones;
+
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+
+            v.pod("format", format);
+            v.pod("vertexCount", vertexCount);
+            v.pod("indiceCountPerFace", indiceCountPerFace);
+            v.pod("materialIndex", materialIndex);
+
+            v.pod("posCount", posCount);
+            v.pod("normalsCount", normalsCount);
+            v.pod("tangentCount", tangentCount);
+            v.pod("binormalCount", binormalCount);
+            for (int i = 0; i < 8; i++)
+                v.pod("uvCount", uvCount[i]);
+            for (int i = 0; i < 8; i++)
+                v.pod("colorCount", colorCount[i]);
+            v.pod("indiceCount", indiceCount);
+
+            v.custom("data", 1, *this, &GeometryView::writeData, &GeometryView::readData);
+
+            v.objects("bones", bones);
+        }
+
+        void writeData(aRibeiro::BinaryWriter* writer)const {
+            uint32_t referenced = 0;
+            for (uint32_t i = 0; i < indiceCount; i++)
+                if (index(i) + 1 > referenced)
+                    referenced = index(i) + 1;
+            uint32_t streamIndexSize = IndexBuffer_Width(referenced);
+            writer->writeUInt32(streamIndexSize);
+
+            writer->writeAlign(16);
+            // small batches converted to the stream layout
+            uint8_t converted[4096];
+            for (int i = 0; i < AttributeCount; i++) {
+                const void **pointer;
+                uint32_t *count;
+                AttributeType type;
+                const_cast<GeometryView*>(this)->attribute(i, &pointer, &count, &type);
+
+                const uint8_t *src = (const uint8_t *)*pointer;
+                size_t element = streamSize(type, streamIndexSize);
+                size_t batch = sizeof(converted) / element;
+                for (size_t first = 0; first < *count; first += batch) {
+                    size_t n = (*count - first < batch) ? *count - first : batch;
+                    for (size_t j = 0; j < n; j++) {
+                        const uint8_t *item = src + (first + j) * memorySize(type, indiceSize);
+                        if (type == AttributeType_Vec3) {
+                            ModelFieldPOD<aRibeiro::vec3>::put(&converted[j * element], *(const aRibeiro::vec3 *)item);
+                            ModelFieldPOD<float>::put(&converted[j * element + 12], 0.0f);
+                        } else if (type == AttributeType_Vec4)
+                            ModelFieldPOD<aRibeiro::vec4>::put(&converted[j * element], *(const aRibeiro::vec4 *)item);
+                        else {
+                            uint32_t v = index((uint32_t)(first + j));
+                            if (streamIndexSize == 1)
+                                converted[j] = (uint8_t)v;
+                            else if (streamIndexSize == 2)
+                                aRibeiro::BinaryEndian::store16(&converted[j * 2], (uint16_t)v);
+                            else
+                                aRibeiro::BinaryEndian::store32(&converted[j * 4], v);
+                        }
+                    }
+                    writer->write(converted, n * element);
+                }
+                writer->writeAlign(16);
+            }
+        }
+
+        void readData(aRibeiro::BinaryReader* reader) {
+            indiceSize = reader->readUInt32();
+            if (indiceSize != 1 && indiceSize != 2 && indiceSize != 4) {
+                reader->setError("Invalid index size.");
+                indiceSize = 4;
+                indiceCount = 0;
+            }
+
+            size_t streamTotal = 0;
+            size_t memoryTotal = 0;
+            for (int i = 0; i < AttributeCount; i++) {
+                const void **pointer;
+                uint32_t *count;
+                AttributeType type;
+                attribute(i, &pointer, &count, &type);
+                *count = reader->validateCount(*count, streamSize(type, indiceSize));
+                streamTotal += align16(*count * streamSize(type, indiceSize));
+                memoryTotal += align16(*count * memorySize(type, indiceSize));
+            }
+
+            reader->readAlign(16);
+            const uint8_t *data = NULL;
+            if (streamTotal > 0)
+                data = reader->readPointer(streamTotal);
+
+            bool inPlace = inPlaceLayout() && !reader->isStreaming() && ((size_t)data & 15) == 0;
+            if (inPlace)
+                storage.clear();
+            else
+                storage.resize(memoryTotal / 16);
+
+            size_t streamOffset = 0;
+            size_t memoryOffset = 0;
+            for (int i = 0; i < AttributeCount; i++) {
+                const void **pointer;
+                uint32_t *count;
+                AttributeType type;
+                attribute(i, &pointer, &count, &type);
+
+                if (data == NULL || *count == 0) {
+                    *count = 0;
+                    *pointer = NULL;
+                    continue;
+                }
+
+                const uint8_t *src = data + streamOffset;
+                streamOffset += align16(*count * streamSize(type, indiceSize));
+
+                if (inPlace) {
+                    *pointer = src;
+                    continue;
+                }
+
+                uint8_t *dst = (uint8_t *)&storage[memoryOffset / 16];
+                size_t element = streamSize(type, indiceSize);
+                memoryOffset += align16(*count * memorySize(type, indiceSize));
+                for (size_t j = 0; j < *count; j++) {
+                    const uint8_t *item = src + j * element;
+                    uint8_t *out = dst + j * memorySize(type, indiceSize);
+                    if (type == AttributeType_Vec3)
+                        ModelFieldPOD<aRibeiro::vec3>::get(item, (aRibeiro::vec3 *)out);
+                    else if (type == AttributeType_Vec4)
+                        ModelFieldPOD<aRibeiro::vec4>::get(item, (aRibeiro::vec4 *)out);
+                    else if (indiceSize == 1)
+                        *out = *item;
+                    else if (indiceSize == 2)
+                        setIndex(out, 2, aRibeiro::BinaryEndian::load16(item));
+                    else
+                        setIndex(out, 4, aRibeiro::BinaryEndian::load32(item));
+                }
+                *pointer = dst;
+            }
+        }
+
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
+        }
+
+        // view over the arrays of a geometry (to write the flat layout)
+        void set(const Geometry &geometry) {
+            clear();
+            name = geometry.name;
+            format = geometry.format;
+            vertexCount = geometry.vertexCount;
+            indiceCountPerFace = geometry.indiceCountPerFace;
+            materialIndex = geometry.materialIndex;
+
+            posCount = (uint32_t)geometry.pos.size();
+            pos = (posCount > 0) ? &geometry.pos[0] : NULL;
+            normalsCount = (uint32_t)geometry.normals.size();
+            normals = (normalsCount > 0) ? &geometry.normals[0] : NULL;
+            tangentCount = (uint32_t)geometry.tangent.size();
+            tangent = (tangentCount > 0) ? &geometry.tangent[0] : NULL;
+            binormalCount = (uint32_t)geometry.binormal.size();
+            binormal = (binormalCount > 0) ? &geometry.binormal[0] : NULL;
+            for (int i = 0; i < 8; i++) {
+                uvCount[i] = (uint32_t)geometry.uv[i].size();
+                uv[i] = (uvCount[i] > 0) ? &geometry.uv[i][0] : NULL;
+                colorCount[i] = (uint32_t)geometry.color[i].size();
+                color[i] = (colorCount[i] > 0) ? &geometry.color[i][0] : NULL;
+            }
+            indiceCount = (uint32_t)geometry.indice.size();
+            indice = (indiceCount > 0) ? &geometry.indice[0] : NULL;
+            indiceSize = sizeof(uint32_t);
+
+            bones = geometry.bones;
+        }
+
+        // copy the arrays to a geometry
+        void copyTo(Geometry *geometry)const {
+            geometry->name = name;
+            geometry->format = format;
+            geometry->vertexCount = vertexCount;
+            geometry->indiceCountPerFace = indiceCountPerFace;
+            geometry->materialIndex = materialIndex;
+
+            geometry->pos.assign(pos, pos + posCount);
+            geometry->normals.assign(normals, normals + normalsCount);
+            geometry->tangent.assign(tangent, tangent + tangentCount);
+            geometry->binormal.assign(binormal, binormal + binormalCount);
+            for (int i = 0; i < 8; i++) {
+                geometry->uv[i].assign(uv[i], uv[i] + uvCount[i]);
+                geometry->color[i].assign(color[i], color[i] + colorCount[i]);
+            }
+            geometry->indice.resize(indiceCount);
+            for (uint32_t i = 0; i < indiceCount; i++)
+                geometry->indice[i] = index(i);
+
+            geometry->bones = bones;
+        }
+
+        // the index i, from any index size
+        uint32_t index(uint32_t i)const {
+            const uint8_t *item = (const uint8_t *)indice + (size_t)i * indiceSize;
+            if (indiceSize == 1)
+                return *item;
+            if (indiceSize == 2) {
+                uint16_t v;
+                memcpy(&v, item, sizeof(uint16_t));
+                return v;
+            }
+            uint32_t v;
+            memcpy(&v, item, sizeof(uint32_t));
+            return v;
+        }
+
+        void clear() {
+            name.clear();
+            format = 0;
+            vertexCount = 0;
+            indiceCountPerFace = 0;
+            materialIndex = 0;
+            indiceSize = sizeof(uint32_t);
+            for (int i = 0; i < AttributeCount; i++) {
+                const void **pointer;
+                uint32_t *count;
+                AttributeType type;
+                attribute(i, &pointer, &count, &type);
+                *pointer = NULL;
+                *count = 0;
+            }
+            bones.clear();
+            storage.clear();
+        }
+
+        // true when the arrays are not copied to the view memory
+        // (they point to the reader memory, or to the geometry from set)
+        bool isInPlace()const {
+            return storage.size() == 0;
+        }
+
+        GeometryView() {
+            clear();
+        }
+
+        GeometryView(const Geometry& geometry) {
+            set(geometry);
+        }
+
+        //copy constructores
+        GeometryView(const GeometryView& v) {
+            (*this) = v;
+        }
+        void operator=(const GeometryView& v) {
+            name = v.name;
+            format = v.format;
+            vertexCount = v.vertexCount;
+            indiceCountPerFace = v.indiceCountPerFace;
+            materialIndex = v.materialIndex;
+            indiceSize = v.indiceSize;
+            bones = v.bones;
+            storage = v.storage;
+            // the arrays in place keep pointing to the same memory, the copied ones to the new storage
+            for (int i = 0; i < AttributeCount; i++) {
+                const void **pointer, **source;
+                uint32_t *count, *sourceCount;
+                AttributeType type;
+                attribute(i, &pointer, &count, &type);
+                const_cast<GeometryView&>(v).attribute(i, &source, &sourceCount, &type);
+                *count = *sourceCount;
+                *pointer = *source;
+                if (v.storage.size() > 0 && *source != NULL)
+                    *pointer = (const uint8_t *)&storage[0] + ((const uint8_t *)*source - (const uint8_t *)&v.storage[0]);
+            }
+        }
+
+        SSE2_CLASS_NEW_OPERATOR
+    }_SSE2_ALIGN_POS;
+
+}
+
+#endif
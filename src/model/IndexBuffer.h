@@ -0,0 +1,196 @@
+#ifndef model_index_buffer_h_
+#define model_index_buffer_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <aRibeiroData/BinaryWriter.h>
+#include <aRibeiroData/BinaryEndian.h>
+#include <vector>
+#include <string.h> // memcpy
+
+namespace model {
+
+    // Index width and index stream codec of the geometry.
+    //
+    // The geometry keeps 32 bits indices. The stream and the GPU buffers use the
+    // smallest width that holds the vertex count: 1, 2 or 4 bytes.
+    //
+    // Stream layout (ModelRevision_Indices):
+    //
+    //   uint8 encoding
+    //   IndexEncoding_UInt8/16/32: varuint count | count x index (little endian)
+    //   IndexEncoding_Delta: varuint count | count x varint (zigzag of the index - the previous index)
+    //
+    // The writer selects the delta encoding when it is smaller than the fixed width.
+    // The triangle lists in the vertex cache order have small deltas, most of them fit in one byte.
+    //
+    // Example:
+    //
+    //   std::vector<uint8_t> indices;
+    //   uint32_t width = model::IndexBuffer_Pack(geometry.indice, geometry.vertexCount, &indices);
+    //
+    //   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), &indices[0], GL_STATIC_DRAW);
+    //   glDrawElements(GL_TRIANGLES, geometry.indice.size(),
+    //                  (width == 1) ? GL_UNSIGNED_BYTE : ((width == 2) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT), 0);
+    //
+
+    enum IndexEncoding {
+        IndexEncoding_UInt8 = 1,
+        IndexEncoding_UInt16 = 2,
+        IndexEncoding_UInt32 = 4,
+        IndexEncoding_Delta = 8
+    };
+
+    // the smallest index width (in bytes) for the vertex count
+    static inline uint32_t IndexBuffer_Width(uint32_t vertexCount) {
+        if (vertexCount <= 0x100)
+            return 1;
+        if (vertexCount <= 0x10000)
+            return 2;
+        return 4;
+    }
+
+    // the vertex count referenced by the indices (max index + 1)
+    static inline uint32_t IndexBuffer_VertexCount(const std::vector<uint32_t> &indices) {
+        uint32_t max = 0;
+        for (size_t i = 0; i < indices.size(); i++)
+            if (indices[i] > max)
+                max = indices[i];
+        return (indices.size() > 0) ? max + 1 : 0;
+    }
+
+    // the indices with the smallest width in the host byte order (for the GPU)
+    // returns the width in bytes: 1, 2 or 4
+    static inline uint32_t IndexBuffer_Pack(const std::vector<uint32_t> &indices, uint32_t vertexCount, std::vector<uint8_t> *output) {
+        uint32_t referenced = IndexBuffer_VertexCount(indices);
+        uint32_t width = IndexBuffer_Width((referenced > vertexCount) ? referenced : vertexCount);
+        output->resize(indices.size() * width);
+        if (indices.size() == 0)
+            return width;
+        uint8_t *out = &(*output)[0];
+        if (width == 1) {
+            for (size_t i = 0; i < indices.size(); i++)
+                out[i] = (uint8_t)indices[i];
+        } else if (width == 2) {
+            for (size_t i = 0; i < indices.size(); i++) {
+                uint16_t v = (uint16_t)indices[i];
+                memcpy(out + i * 2, &v, sizeof(uint16_t));
+            }
+        } else
+            memcpy(out, &indices[0], indices.size() * sizeof(uint32_t));
+        return width;
+    }
+
+    static inline uint32_t IndexBuffer_ZigZag(uint32_t index, uint32_t previous) {
+        int32_t delta = (int32_t)(index - previous);
+        return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    }
+
+    // bytes of the delta encoding (without the count)
+    static inline size_t IndexBuffer_DeltaSize(const std::vector<uint32_t> &indices) {
+        size_t size = 0;
+        uint32_t previous = 0;
+        for (size_t i = 0; i < indices.size(); i++) {
+            uint32_t zigzag = IndexBuffer_ZigZag(indices[i], previous);
+            previous = indices[i];
+            size += (zigzag < (1u << 7)) ? 1 : (zigzag < (1u << 14)) ? 2 : (zigzag < (1u << 21)) ? 3 : (zigzag < (1u << 28)) ? 4 : 5;
+        }
+        return size;
+    }
+
+    static inline void IndexBuffer_Write(aRibeiro::BinaryWriter *writer, const std::vector<uint32_t> &indices) {
+        uint32_t width = IndexBuffer_Width(IndexBuffer_VertexCount(indices));
+        if (IndexBuffer_DeltaSize(indices) < indices.size() * width) {
+            writer->writeUInt8(IndexEncoding_Delta);
+            writer->writeVectorUInt32Delta(indices);
+            return;
+        }
+
+        writer->writeUInt8((uint8_t)width);
+        writer->writeVarUInt32((uint32_t)indices.size());
+        // small batches converted to the stream width
+        uint8_t converted[4096];
+        size_t batch = sizeof(converted) / width;
+        for (size_t first = 0; first < indices.size(); first += batch) {
+            size_t n = (indices.size() - first < batch) ? indices.size() - first : batch;
+            for (size_t j = 0; j < n; j++) {
+                uint32_t v = indices[first + j];
+                if (width == 1)
+                    converted[j] = (uint8_t)v;
+                else if (width == 2)
+                    aRibeiro::BinaryEndian::store16(&converted[j * 2], (uint16_t)v);
+                else
+                    aRibeiro::BinaryEndian::store32(&converted[j * 4], v);
+            }
+            writer->write(converted, n * width);
+        }
+    }
+
+    static inline void IndexBuffer_Read(aRibeiro::BinaryReader *reader, std::vector<uint32_t> *indices) {
+        uint8_t encoding = reader->readUInt8();
+        if (encoding == IndexEncoding_Delta) {
+            reader->readVectorUInt32Delta(indices);
+            return;
+        }
+        if (encoding != IndexEncoding_UInt8 && encoding != IndexEncoding_UInt16 && encoding != IndexEncoding_UInt32) {
+            reader->setError("Invalid index encoding.");
+            indices->clear();
+            return;
+        }
+
+        uint32_t width = encoding;
+        indices->resize(reader->validateCount(reader->readVarUInt32(), width));
+        if (indices->size() == 0)
+            return;
+
+        // the packed indices are read to the start of the vector memory,
+        // and widened in place from the last one
+        uint8_t *bytes = (uint8_t *)&(*indices)[0];
+        size_t total = indices->size() * width;
+        const size_t chunk = 1 << 16;
+        for (size_t offset = 0; offset < total; offset += chunk)
+            reader->read(bytes + offset, (int)((total - offset < chunk) ? total - offset : chunk));
+
+        for (size_t i = indices->size(); i-- > 0;) {
+            const uint8_t *item = bytes + i * width;
+            if (width == 1)
+                (*indices)[i] = item[0];
+            else if (width == 2)
+                (*indices)[i] = aRibeiro::BinaryEndian::load16(item);
+            else
+                (*indices)[i] = aRibeiro::BinaryEndian::load32(item);
+        }
+    }
+
+    // 32 bits indices in the 16 bits array layout of the older revisions:
+    // uint32 count | count x uint16
+    static inline void IndexBuffer_Write16(aRibeiro::BinaryWriter *writer, const std::vector<uint32_t> &indices) {
+        writer->writeUInt32((uint32_t)indices.size());
+        uint8_t converted[4096];
+        size_t batch = sizeof(converted) / sizeof(uint16_t);
+        for (size_t first = 0; first < indices.size(); first += batch) {
+            size_t n = (indices.size() - first < batch) ? indices.size() - first : batch;
+            for (size_t j = 0; j < n; j++) {
+                uint32_t v = indices[first + j];
+                ARIBEIRO_ABORT(v > 0xffff, "Index greater than 65535 in a layout revision with 16 bits indices.\n");
+                aRibeiro::BinaryEndian::store16(&converted[j * 2], (uint16_t)v);
+            }
+            writer->write(converted, n * sizeof(uint16_t));
+        }
+    }
+
+    static inline void IndexBuffer_Read16(aRibeiro::BinaryReader *reader, std::vector<uint32_t> *indices) {
+        indices->resize(reader->validateCount(reader->readUInt32(), sizeof(uint16_t)));
+        uint8_t converted[4096];
+        size_t batch = sizeof(converted) / sizeof(uint16_t);
+        for (size_t first = 0; first < indices->size(); first += batch) {
+            size_t n = (indices->size() - first < batch) ? indices->size() - first : batch;
+            reader->read(converted, (int)(n * sizeof(uint16_t)));
+            for (size_t j = 0; j < n; j++)
+                (*indices)[first + j] = aRibeiro::BinaryEndian::load16(&converted[j * 2]);
+        }
+    }
+
+}
+
+#endif
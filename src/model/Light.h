@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     enum LightType {
@@ -40,14 +42,18 @@ namespace model {
         aRibeiro::vec3 direction;
         aRibeiro::vec3 up;
         
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeVec3(direction);
-            writer->writeVec3(up);
+        template <typename V>
+        void fields(V &v) {
+            v.pod("direction", direction);
+            v.pod("up", up);
         }
         
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
         void read(aRibeiro::BinaryReader* reader) {
-            direction = reader->readVec3();
-            up = reader->readVec3();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -56,12 +62,17 @@ namespace model {
     struct _SSE2_ALIGN_PRE PointLight {
         aRibeiro::vec3 position;
         
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeVec3(position);
+        template <typename V>
+        void fields(V &v) {
+            v.pod("position", position);
         }
         
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
         void read(aRibeiro::BinaryReader* reader) {
-            position = reader->readVec3();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -79,20 +90,21 @@ namespace model {
             angleOuterCone = 0;
         }
         
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeVec3(position);
-            writer->writeVec3(direction);
-            writer->writeVec3(up);
-            writer->writeFloat(angleInnerCone);
-            writer->writeFloat(angleOuterCone);
+        template <typename V>
+        void fields(V &v) {
+            v.pod("position", position);
+            v.pod("direction", direction);
+            v.pod("up", up);
+            v.pod("angleInnerCone", angleInnerCone);
+            v.pod("angleOuterCone", angleOuterCone);
         }
         
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
         void read(aRibeiro::BinaryReader* reader) {
-            position = reader->readVec3();
-            direction = reader->readVec3();
-            up = reader->readVec3();
-            angleInnerCone = reader->readFloat();
-            angleOuterCone = reader->readFloat();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -103,16 +115,19 @@ namespace model {
         aRibeiro::vec3 direction;
         aRibeiro::vec3 up;
         
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeVec3(position);
-            writer->writeVec3(direction);
-            writer->writeVec3(up);
+        template <typename V>
+        void fields(V &v) {
+            v.pod("position", position);
+            v.pod("direction", direction);
+            v.pod("up", up);
         }
         
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
         void read(aRibeiro::BinaryReader* reader) {
-            position = reader->readVec3();
-            direction = reader->readVec3();
-            up = reader->readVec3();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -124,18 +139,20 @@ namespace model {
         aRibeiro::vec3 up;
         aRibeiro::vec2 size;
         
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeVec3(position);
-            writer->writeVec3(direction);
-            writer->writeVec3(up);
-            writer->writeVec2(size);
+        template <typename V>
+        void fields(V &v) {
+            v.pod("position", position);
+            v.pod("direction", direction);
+            v.pod("up", up);
+            v.pod("size", size);
         }
         
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
+
         void read(aRibeiro::BinaryReader* reader) {
-            position = reader->readVec3();
-            direction = reader->readVec3();
-            up = reader->readVec3();
-            size = reader->readVec2();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -163,46 +180,35 @@ namespace model {
         aRibeiro::vec3 colorSpecular;
         aRibeiro::vec3 colorAmbient;
 
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeString(name);
-            writer->writeUInt8(type);
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+            v.enum8("type", type);
             
-            directional.write(writer);
-            point.write(writer);
-            spot.write(writer);
-            ambient.write(writer);
-            area.write(writer);
+            // a single pod run: the whole light after the name is one read call
+            v.object("directional", directional);
+            v.object("point", point);
+            v.object("spot", spot);
+            v.object("ambient", ambient);
+            v.object("area", area);
 
             // d = distance
             // Atten = 1/( att0 + att1 * d + att2 * d*d)
-            writer->writeFloat(attenuationConstant);
-            writer->writeFloat(attenuationLinear);
-            writer->writeFloat(attenuationQuadratic);
+            v.pod("attenuationConstant", attenuationConstant);
+            v.pod("attenuationLinear", attenuationLinear);
+            v.pod("attenuationQuadratic", attenuationQuadratic);
 
-            writer->writeVec3(colorDiffuse);
-            writer->writeVec3(colorSpecular);
-            writer->writeVec3(colorAmbient);
+            v.pod("colorDiffuse", colorDiffuse);
+            v.pod("colorSpecular", colorSpecular);
+            v.pod("colorAmbient", colorAmbient);
         }
 
-        void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
-            type = (LightType)reader->readUInt8();
-            
-            directional.read(reader);
-            point.read(reader);
-            spot.read(reader);
-            ambient.read(reader);
-            area.read(reader);
-            
-            // d = distance
-            // Atten = 1/( att0 + att1 * d + att2 * d*d)
-            attenuationConstant = reader->readFloat();
-            attenuationLinear = reader->readFloat();
-            attenuationQuadratic = reader->readFloat();
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
+        }
 
-            colorDiffuse = reader->readVec3();
-            colorSpecular = reader->readVec3();
-            colorAmbient = reader->readVec3();
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
         }
         
         Light() {
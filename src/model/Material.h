@@ -9,6 +9,8 @@
 
 #include "Texture.h"
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE Material {
@@ -26,28 +28,27 @@ namespace model {
         //std::string textureDiffuse;
         //std::string textureNormal;
 
-        void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeString(name);
-            writer->writeStringMapFloat(floatValue);
-            writer->writeStringMapVec2(vec2Value);
-            writer->writeStringMapVec3(vec3Value);
-            writer->writeStringMapVec4(vec4Value);
-            writer->writeStringMapInt32(intValue);
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+            // revision 2: the keys repeat in all materials, they go to the string table
+            v.map("floatValue", floatValue, &aRibeiro::BinaryWriter::writeFloat, &aRibeiro::BinaryReader::readFloat);
+            v.map("vec2Value", vec2Value, &aRibeiro::BinaryWriter::writeVec2, &aRibeiro::BinaryReader::readVec2);
+            v.map("vec3Value", vec3Value, &aRibeiro::BinaryWriter::writeVec3, &aRibeiro::BinaryReader::readVec3);
+            v.map("vec4Value", vec4Value, &aRibeiro::BinaryWriter::writeVec4, &aRibeiro::BinaryReader::readVec4);
+            v.map("intValue", intValue, &aRibeiro::BinaryWriter::writeInt32, &aRibeiro::BinaryReader::readInt32);
             
-            aRibeiro::BinaryWriter_WriteAlignedVector<Texture>(writer,textures);
+            v.objects("textures", textures);
         }
 
-        void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
-            reader->readStringMapFloat(&floatValue);
-            reader->readStringMapVec2(&vec2Value);
-            reader->readStringMapVec3(&vec3Value);
-            reader->readStringMapVec4(&vec4Value);
-            reader->readStringMapInt32(&intValue);
-            
-            aRibeiro::BinaryReader_ReadAlignedVector<Texture>(reader,&textures);
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
         }
 
+        void read(aRibeiro::BinaryReader* reader) {
+            ModelFields_Read(reader, this);
+        }
+        
         Material() {
 
         }
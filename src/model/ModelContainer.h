@@ -13,9 +13,14 @@
 #include "Material.h"
 #include "Geometry.h"
 #include "Node.h"
+#include "ModelFields.h"
 
 namespace model {
 
+    // stream header: magic "BAMS" | uint32 revision | uint32 schema hash (revision >= 3)
+    // the legacy streams start straight with the animations
+    const uint8_t ModelContainer_Magic[4] = { 'B', 'A', 'M', 'S' };
+
     class _SSE2_ALIGN_PRE ModelContainer {
     public:
         aRibeiro::aligned_vector<Animation> animations;
@@ -25,17 +30,69 @@ namespace model {
         aRibeiro::aligned_vector<Geometry> geometries;
         aRibeiro::aligned_vector<Node> nodes;//the node[0] is the root
         
+        template <typename V>
+        void fields(V &v) {
+            v.objects("animations", animations);
+            v.objects("lights", lights);
+            v.objects("cameras", cameras);
+            v.objects("materials", materials);
+            v.objects("geometries", geometries);
+            v.objects("nodes", nodes);
+        }
+
+        void writeHeader(aRibeiro::BinaryWriter* writer)const {
+            writer->revision = ModelRevision_Current;
+            writer->write((void*)ModelContainer_Magic, 4);
+            writer->writeUInt32(writer->revision);
+            if (writer->revision >= ModelRevision_SchemaHash)
+                writer->writeUInt32(ModelFields_SchemaHash<ModelContainer>(writer->revision));
+        }
+
+        void readHeader(aRibeiro::BinaryReader* reader) {
+            uint8_t magic[4];
+            if (!reader->peek(magic, 4) || memcmp(magic, ModelContainer_Magic, 4) != 0) {
+                reader->revision = ModelRevision_Legacy;
+                return;
+            }
+            reader->read(magic, 4);
+            reader->revision = reader->readUInt32();
+            if (reader->revision > ModelRevision_Current) {
+                reader->setError("Unsupported model revision.");
+                return;
+            }
+            // the file was written with a different field list for the same revision
+            if (reader->revision >= ModelRevision_SchemaHash &&
+                reader->readUInt32() != ModelFields_SchemaHash<ModelContainer>(reader->revision))
+                reader->setError("Model schema mismatch.");
+        }
+
+        void write(aRibeiro::BinaryWriter* writer)const {
+            writeHeader(writer);
+            ModelFields_Write(writer, *this);
+        }
+
+        void read(aRibeiro::BinaryReader* reader) {
+            readHeader(reader);
+            ModelFields_Read(reader, this);
+        }
+
+        // size of the uncompressed stream, computed by a write pass that only counts bytes.
+        // Can be used to reserve the BinaryWriter buffer before write the container to memory.
+        size_t estimateSerializedSize()const {
+            aRibeiro::BinaryWriter writer;
+            writer.writeToCounter();
+            write(&writer);
+            return writer.writtenSize();
+        }
+
         void write(const char* filename)const {
             
             aRibeiro::BinaryWriter writer;
-            writer.writeToFile(filename, true);
+            // stream the compressed data to the file, keeping
+            // the memory usage bounded by the chunk size
+            writer.writeToFileStream(filename, true);
             
-            aRibeiro::BinaryWriter_WriteAlignedVector<Animation>(&writer,animations);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Light>(&writer,lights);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Camera>(&writer,cameras);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Material>(&writer,materials);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Geometry>(&writer,geometries);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Node>(&writer,nodes);
+            write(&writer);
             
             writer.close();
         }
@@ -43,14 +100,11 @@ namespace model {
         void read(const char* filename) {
             
             aRibeiro::BinaryReader reader;
-            reader.readFromFile(filename, true);
-
-            aRibeiro::BinaryReader_ReadAlignedVector<Animation>(&reader,&animations);
-            aRibeiro::BinaryReader_ReadAlignedVector<Light>(&reader,&lights);
-            aRibeiro::BinaryReader_ReadAlignedVector<Camera>(&reader,&cameras);
-            aRibeiro::BinaryReader_ReadAlignedVector<Material>(&reader,&materials);
-            aRibeiro::BinaryReader_ReadAlignedVector<Geometry>(&reader,&geometries);
-            aRibeiro::BinaryReader_ReadAlignedVector<Node>(&reader,&nodes);
+            // inflate on demand, keeping only a small
+            // window of the uncompressed data in memory
+            reader.readFromFileStream(filename, true);
+
+            read(&reader);
             
             reader.close();
         }
@@ -0,0 +1,416 @@
+#ifndef model_model_container_chunked_h_
+#define model_model_container_chunked_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <aRibeiroData/BinaryWriter.h>
+#include <aRibeiroData/BinaryEndian.h>
+#include <vector>
+#include <map>
+
+#include "ModelContainer.h"
+
+namespace model {
+
+    // BAMC (Binary Asilva Mesh Chunked) layout:
+    //
+    //   magic "BAMC" | uint32 version | uint32 revision (version >= 2) | uint32 schema hash (revision >= 3) | uint32 chunkCount
+    //   TOC: chunkCount x { uint32 type | uint32 index | uint64 offset | uint64 compressedSize | uint64 uncompressedSize }
+    //   chunks: each one is an independent zlib stream
+    //
+    // There is one chunk for each section and one chunk for each geometry,
+    // so any of them can be loaded without inflate the rest of the file.
+    //
+    // The revision is the layout of the model classes in the chunks (see ModelRevision.h).
+    // The version 1 files have no revision field: they use the legacy layout.
+    //
+    // The open checks the table of contents against the file size. The read methods return
+    // false when the chunk is not in the file or it cannot be read (and, after a
+    // setAbortOnError(false), when the chunk data is corrupted).
+
+    const uint32_t BAMC_VERSION = 2;
+
+    enum ChunkType {
+        ChunkType_Animations = 0x0,
+        ChunkType_Lights = 0x1,
+        ChunkType_Cameras = 0x2,
+        ChunkType_Materials = 0x3,
+        ChunkType_Geometry = 0x4,
+        ChunkType_Nodes = 0x5
+    };
+
+    class ChunkEntry {
+    public:
+        uint32_t type;
+        uint32_t index;
+        uint64_t offset;
+        uint64_t compressedSize;
+        uint64_t uncompressedSize;
+
+        static size_t serializedSize() {
+            return sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3;
+        }
+
+        void write(aRibeiro::BinaryWriter* writer)const {
+            writer->writeUInt32(type);
+            writer->writeUInt32(index);
+            writer->writeUInt64(offset);
+            writer->writeUInt64(compressedSize);
+            writer->writeUInt64(uncompressedSize);
+        }
+
+        void read(aRibeiro::BinaryReader* reader) {
+            type = reader->readUInt32();
+            index = reader->readUInt32();
+            offset = reader->readUInt64();
+            compressedSize = reader->readUInt64();
+            uncompressedSize = reader->readUInt64();
+        }
+
+        ChunkEntry() {
+            type = 0;
+            index = 0;
+            offset = 0;
+            compressedSize = 0;
+            uncompressedSize = 0;
+        }
+    };
+
+    static inline int BAMC_Seek(FILE *file, uint64_t offset) {
+#if defined(_WIN32)
+        return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+        return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+    }
+
+    static inline uint64_t BAMC_FileSize(FILE *file) {
+#if defined(_WIN32)
+        _fseeki64(file, 0, SEEK_END);
+        __int64 size = _ftelli64(file);
+#else
+        fseeko(file, 0, SEEK_END);
+        off_t size = ftello(file);
+#endif
+        return (size > 0) ? (uint64_t)size : 0;
+    }
+
+    static inline bool BAMC_ReadUInt32(FILE *file, uint32_t *v) {
+        uint8_t data[4];
+        if (fread(data, sizeof(uint8_t), 4, file) != 4)
+            return false;
+        *v = aRibeiro::BinaryEndian::load32(data);
+        return true;
+    }
+
+    class ModelContainerChunked {
+
+        FILE *in;
+        std::vector<ChunkEntry> toc;
+        std::vector<uint8_t> chunkData;
+        uint32_t geometryCount;
+        uint32_t revision;
+        bool abortOnError;
+
+        //private copy constructores, to avoid copy...
+        ModelContainerChunked(const ModelContainerChunked&) {}
+        void operator=(const ModelContainerChunked&) {}
+
+        const ChunkEntry* findChunk(uint32_t type, uint32_t index)const {
+            for (size_t i = 0; i < toc.size(); i++) {
+                if (toc[i].type == type && toc[i].index == index)
+                    return &toc[i];
+            }
+            return NULL;
+        }
+
+        // fetch only the compressed bytes of one chunk and inflate them
+        // returns false when the file is not opened, the chunk is not in the file or it cannot be read
+        bool openChunk(uint32_t type, uint32_t index, aRibeiro::BinaryReader *reader) {
+            const ChunkEntry *entry = (in != NULL) ? findChunk(type, index) : NULL;
+            if (entry == NULL)
+                return false;
+
+            // the open checked the chunk is inside the file
+            chunkData.resize((size_t)entry->compressedSize);
+            size_t readed = 0;
+            if (BAMC_Seek(in, entry->offset) == 0 && chunkData.size() > 0)
+                readed = fread(&chunkData[0], sizeof(uint8_t), chunkData.size(), in);
+            if (readed != chunkData.size()) {
+                chunkData.clear();
+                return false;
+            }
+
+            reader->setAbortOnError(abortOnError);
+            bool result = reader->readFromBuffer((chunkData.size() > 0) ? &chunkData[0] : NULL, chunkData.size(), true);
+            reader->revision = revision;
+            chunkData.clear();
+            return result;
+        }
+
+        template <typename T>
+        static ChunkEntry writeChunk(FILE *out, uint64_t offset, uint32_t type, uint32_t index, const T &data) {
+            aRibeiro::BinaryWriter writer;
+            writer.writeToBuffer(true);
+            writer.revision = ModelRevision_Current;
+            data.write(&writer);
+            size_t uncompressedSize = writer.writtenSize();
+            writer.close();
+
+            if (writer.buffer.size() > 0)
+                fwrite(&writer.buffer[0], sizeof(uint8_t), writer.buffer.size(), out);
+
+            ChunkEntry entry;
+            entry.type = type;
+            entry.index = index;
+            entry.offset = offset;
+            entry.compressedSize = writer.buffer.size();
+            entry.uncompressedSize = uncompressedSize;
+            return entry;
+        }
+
+        template <typename T>
+        class SectionRef {
+        public:
+            const aRibeiro::aligned_vector<T> &v;
+            SectionRef(const aRibeiro::aligned_vector<T> &_v) :v(_v) {}
+            void write(aRibeiro::BinaryWriter* writer)const {
+                aRibeiro::BinaryWriter_WriteAlignedVector<T>(writer, v);
+            }
+        };
+
+    public:
+
+        ModelContainerChunked() {
+            in = NULL;
+            geometryCount = 0;
+            revision = ModelRevision_Legacy;
+            abortOnError = true;
+        }
+
+        ~ModelContainerChunked() {
+            close();
+        }
+
+        // write the container as a BAMC file
+        static void write(const ModelContainer &container, const char* filename) {
+            FILE *out = fopen(filename, "wb");
+            ARIBEIRO_ABORT(out == NULL, "Error to open file: %s\n", filename);
+
+            std::vector<ChunkEntry> toc;
+            uint32_t chunkCount = 5 + (uint32_t)container.geometries.size();
+            uint64_t headerSize = 4 + sizeof(uint32_t) * 4 + ChunkEntry::serializedSize() * chunkCount;
+
+            // reserve the header, it is written after all chunks
+            std::vector<uint8_t> zero((size_t)headerSize, 0);
+            fwrite(&zero[0], sizeof(uint8_t), zero.size(), out);
+
+            uint64_t offset = headerSize;
+            toc.push_back(writeChunk(out, offset, ChunkType_Animations, 0, SectionRef<Animation>(container.animations)));
+            offset += toc.back().compressedSize;
+            toc.push_back(writeChunk(out, offset, ChunkType_Lights, 0, SectionRef<Light>(container.lights)));
+            offset += toc.back().compressedSize;
+            toc.push_back(writeChunk(out, offset, ChunkType_Cameras, 0, SectionRef<Camera>(container.cameras)));
+            offset += toc.back().compressedSize;
+            toc.push_back(writeChunk(out, offset, ChunkType_Materials, 0, SectionRef<Material>(container.materials)));
+            offset += toc.back().compressedSize;
+            for (size_t i = 0; i < container.geometries.size(); i++) {
+                toc.push_back(writeChunk(out, offset, ChunkType_Geometry, (uint32_t)i, container.geometries[i]));
+                offset += toc.back().compressedSize;
+            }
+            toc.push_back(writeChunk(out, offset, ChunkType_Nodes, 0, SectionRef<Node>(container.nodes)));
+            offset += toc.back().compressedSize;
+
+            aRibeiro::BinaryWriter header;
+            header.writeToBuffer(false);
+            header.write((void*)"BAMC", 4);
+            header.writeUInt32(BAMC_VERSION);
+            header.writeUInt32(ModelRevision_Current);
+            header.writeUInt32(ModelFields_SchemaHash<ModelContainer>(ModelRevision_Current));
+            header.writeUInt32(chunkCount);
+            for (size_t i = 0; i < toc.size(); i++)
+                toc[i].write(&header);
+            header.close();
+
+            BAMC_Seek(out, 0);
+            fwrite(&header.buffer[0], sizeof(uint8_t), header.buffer.size(), out);
+            fclose(out);
+        }
+
+        // open the file and load only the table of contents
+        bool open(const char* filename) {
+            close();
+
+            in = fopen(filename, "rb");
+            if (in == NULL)
+                return false;
+
+            uint64_t fileSize = BAMC_FileSize(in);
+            BAMC_Seek(in, 0);
+
+            uint8_t magic[4];
+            uint32_t version;
+            if (fread(magic, sizeof(uint8_t), 4, in) != 4 ||
+                memcmp(magic, "BAMC", 4) != 0 ||
+                !BAMC_ReadUInt32(in, &version) ||
+                version > BAMC_VERSION) {
+                close();
+                return false;
+            }
+            uint64_t tocOffset = 4 + sizeof(uint32_t);
+
+            // the version 1 files have no revision field
+            uint32_t fileRevision = ModelRevision_Legacy;
+            if (version >= 2) {
+                if (!BAMC_ReadUInt32(in, &fileRevision) ||
+                    fileRevision > ModelRevision_Current) {
+                    close();
+                    return false;
+                }
+                tocOffset += sizeof(uint32_t);
+            }
+            if (fileRevision >= ModelRevision_SchemaHash) {
+                uint32_t schemaHash;
+                if (!BAMC_ReadUInt32(in, &schemaHash) ||
+                    schemaHash != ModelFields_SchemaHash<ModelContainer>(fileRevision)) {
+                    close();
+                    return false;
+                }
+                tocOffset += sizeof(uint32_t);
+            }
+
+            uint32_t chunkCount;
+            if (!BAMC_ReadUInt32(in, &chunkCount)) {
+                close();
+                return false;
+            }
+            tocOffset += sizeof(uint32_t);
+
+            // the count comes from the file: check it against the file size before the allocation
+            uint64_t tocSize = (uint64_t)ChunkEntry::serializedSize() * chunkCount;
+            if (tocSize > fileSize - tocOffset) {
+                close();
+                return false;
+            }
+
+            std::vector<uint8_t> tocData((size_t)tocSize);
+            if (tocData.size() > 0 &&
+                fread(&tocData[0], sizeof(uint8_t), tocData.size(), in) != tocData.size()) {
+                close();
+                return false;
+            }
+
+            aRibeiro::BinaryReader reader;
+            reader.readFromBorrowedBuffer((tocData.size() > 0) ? &tocData[0] : NULL, tocData.size());
+            toc.resize(chunkCount);
+            geometryCount = 0;
+            for (size_t i = 0; i < toc.size(); i++) {
+                toc[i].read(&reader);
+                if (toc[i].type == ChunkType_Geometry)
+                    geometryCount++;
+            }
+            reader.close();
+
+            // each chunk need to be after the table of contents and inside the file
+            uint64_t chunksOffset = tocOffset + tocSize;
+            for (size_t i = 0; i < toc.size(); i++) {
+                if (toc[i].offset < chunksOffset || toc[i].offset > fileSize ||
+                    toc[i].compressedSize > fileSize - toc[i].offset) {
+                    close();
+                    return false;
+                }
+            }
+
+            revision = fileRevision;
+            return true;
+        }
+
+        // false: corrupted chunk data is reported by the read methods return, instead of abort the application
+        void setAbortOnError(bool abortOnError) {
+            this->abortOnError = abortOnError;
+        }
+
+        void close() {
+            if (in != NULL)
+                fclose(in);
+            in = NULL;
+            toc.clear();
+            geometryCount = 0;
+        }
+
+        const std::vector<ChunkEntry> &tableOfContents()const {
+            return toc;
+        }
+
+        uint32_t getGeometryCount()const {
+            return geometryCount;
+        }
+
+        bool readAnimations(aRibeiro::aligned_vector<Animation> *animations) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Animations, 0, &reader))
+                return false;
+            ModelFields_ReadObjects(&reader, animations);
+            return !reader.hasError();
+        }
+
+        bool readLights(aRibeiro::aligned_vector<Light> *lights) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Lights, 0, &reader))
+                return false;
+            ModelFields_ReadObjects(&reader, lights);
+            return !reader.hasError();
+        }
+
+        bool readCameras(aRibeiro::aligned_vector<Camera> *cameras) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Cameras, 0, &reader))
+                return false;
+            ModelFields_ReadObjects(&reader, cameras);
+            return !reader.hasError();
+        }
+
+        bool readMaterials(aRibeiro::aligned_vector<Material> *materials) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Materials, 0, &reader))
+                return false;
+            ModelFields_ReadObjects(&reader, materials);
+            return !reader.hasError();
+        }
+
+        bool readGeometry(uint32_t index, Geometry *geometry) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Geometry, index, &reader))
+                return false;
+            geometry->read(&reader);
+            return !reader.hasError();
+        }
+
+        // the node hierarchy (node[0] is the root)
+        bool readNodes(aRibeiro::aligned_vector<Node> *nodes) {
+            aRibeiro::BinaryReader reader;
+            if (!openChunk(ChunkType_Nodes, 0, &reader))
+                return false;
+            ModelFields_ReadObjects(&reader, nodes);
+            return !reader.hasError();
+        }
+
+        bool readAll(ModelContainer *container) {
+            if (!readAnimations(&container->animations) ||
+                !readLights(&container->lights) ||
+                !readCameras(&container->cameras) ||
+                !readMaterials(&container->materials))
+                return false;
+            container->geometries.resize(geometryCount);
+            for (uint32_t i = 0; i < geometryCount; i++) {
+                if (!readGeometry(i, &container->geometries[i]))
+                    return false;
+            }
+            return readNodes(&container->nodes);
+        }
+
+    };
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef model_model_container_pool_h_
+#define model_model_container_pool_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <vector>
+
+#include "ModelContainer.h"
+
+namespace model {
+
+    // Recycles the containers of scenes that are loaded and unloaded all the time.
+    //
+    // This is not an arena: the memory of a container is not taken from a few blocks.
+    // A released container keeps its memory (the vectors, strings and the geometry
+    // arrays), and the next load reads over it, resizing the arrays inside the capacity
+    // they already have. The release is O(1) because it frees nothing.
+    //
+    // What still allocates or frees:
+    //
+    // - a load bigger than the recycled container grows its arrays;
+    // - a load smaller than the recycled container destroys the extra elements
+    //   (a geometry or node destroyed frees its arrays, and the next bigger load
+    //   allocates them again);
+    // - the material maps (std::map) allocate one node for each entry read;
+    // - the free list grows with each container released, the memory of the
+    //   released containers is freed only by #trim.
+    //
+    // The pool reader keeps its file and inflate buffers between the loads too.
+    //
+    // Example:
+    //
+    //   model::ModelContainerPool pool;
+    //
+    //   model::ModelContainer *scene = pool.load("level_01.bams");
+    //   if (scene == NULL)
+    //       printf("%s\n", pool.getError().c_str());
+    //   ...
+    //   pool.release(scene);
+    //
+    //   scene = pool.load("level_02.bams");
+    //
+    class ModelContainerPool {
+
+        std::vector<ModelContainer*> freeList;
+
+        aRibeiro::BinaryReader reader;
+        std::string error;
+
+        //private copy constructores, to avoid copy...
+        ModelContainerPool(const ModelContainerPool&) {}
+        void operator=(const ModelContainerPool&) {}
+
+    public:
+
+        // reserveCount: the released containers kept before the free list grows
+        ModelContainerPool(size_t reserveCount = 4) {
+            freeList.reserve(reserveCount);
+        }
+
+        ~ModelContainerPool() {
+            trim(0);
+        }
+
+        // a recycled container (with the content of its last load), or a new one
+        ModelContainer* acquire() {
+            if (freeList.size() == 0)
+                return new ModelContainer();
+            ModelContainer* container = freeList.back();
+            freeList.pop_back();
+            return container;
+        }
+
+        // O(1): nothing is freed, the container memory is kept to the next load.
+        // The free list grows to hold all the released containers, the #trim frees them.
+        void release(ModelContainer* container) {
+            if (container == NULL)
+                return;
+            freeList.push_back(container);
+        }
+
+        // release the memory of the containers not in use
+        void trim(size_t keep) {
+            while (freeList.size() > keep) {
+                delete freeList.back();
+                freeList.pop_back();
+            }
+        }
+
+        // the pool reader aborts on errors by default (see BinaryReader::setAbortOnError)
+        void setAbortOnError(bool abortOnError) {
+            reader.setAbortOnError(abortOnError);
+        }
+
+        // the error message of the last load that returned NULL
+        const std::string &getError()const {
+            return error;
+        }
+
+        // load a container file (BAMS) over a recycled container.
+        // Returns NULL when the file cannot be opened or its data is corrupted.
+        ModelContainer* load(const char* filename) {
+            // the whole file mode reuses the reader buffers, the streaming mode allocates its window
+            if (!reader.readFromFile(filename, true)) {
+                error = reader.hasError() ? reader.getError() : std::string("Error to open file: ") + filename;
+                reader.close();
+                return NULL;
+            }
+            ModelContainer* container = load(&reader);
+            reader.close();
+            return container;
+        }
+
+        // read a container from a reader over a recycled container.
+        // Returns NULL when the reader has an error after the read, the container goes back to the pool.
+        ModelContainer* load(aRibeiro::BinaryReader* reader) {
+            ModelContainer* container = acquire();
+            container->read(reader);
+            if (reader->hasError()) {
+                error = reader->getError();
+                release(container);
+                return NULL;
+            }
+            return container;
+        }
+
+    };
+
+}
+
+#endif
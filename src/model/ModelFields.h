@@ -0,0 +1,658 @@
+#ifndef model_model_fields_h_
+#define model_model_fields_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <aRibeiroData/BinaryWriter.h>
+#include <aRibeiroData/BinaryEndian.h>
+#include <vector>
+#include <map>
+#include <string.h> // memcpy
+
+#include "ModelRevision.h"
+#include "IndexBuffer.h"
+
+namespace model {
+
+    // Field descriptors of the data-model classes.
+    //
+    // Each class lists its fields once, in the stream order:
+    //
+    //   template <typename V>
+    //   void fields(V &v) {
+    //       v.name("name", name);
+    //       v.pod("pos", pos);
+    //       v.pod("aspect", aspect);
+    //       if (v.revision >= ModelRevision_Varint)
+    //           v.varuint("count", count);
+    //       v.objects("keys", keys);
+    //   }
+    //
+    // and the same list is visited to write (ModelFields_Write), to read (ModelFields_Read)
+    // and to compute the schema hash (ModelFields_SchemaHash), so the read and the write
+    // cannot drift apart.
+    //
+    // v.custom("id", layout, *this, &Class::writeFn, &Class::readFn) writes and reads the field
+    // with member functions. Only the id and the layout number go to the schema hash:
+    // increment the layout each time the writeFn or the readFn stream changes.
+    //
+    // v.readReset("id", *this, &Class::resetFn) calls resetFn only in the read, without
+    // stream data: it sets the members a revision does not store (a reused object
+    // keeps its previous values otherwise).
+    //
+    // The field list can test v.revision, but not the values being read:
+    // the reader visits the list once before the read to compute the pod run sizes.
+    //
+    // Consecutive pod fields (also from nested objects) are packed in one run:
+    // the writer makes one write call per run and the reader one read call
+    // (one bounds check and one copy) per run.
+
+    // run buffer size: longer runs are split
+    const size_t ModelFields_RunSize = 256;
+    const size_t ModelFields_MaxRuns = 16;
+
+    // little endian encoding of the pod field types
+    template <typename T>
+    struct ModelFieldPOD;
+
+    template <>
+    struct ModelFieldPOD<uint8_t> {
+        static const size_t Size = 1;
+        static const char* tag() { return "u8"; }
+        static void put(uint8_t *out, const uint8_t &v) { out[0] = v; }
+        static void get(const uint8_t *in, uint8_t *v) { *v = in[0]; }
+    };
+
+    template <>
+    struct ModelFieldPOD<uint32_t> {
+        static const size_t Size = 4;
+        static const char* tag() { return "u32"; }
+        static void put(uint8_t *out, const uint32_t &v) { aRibeiro::BinaryEndian::store32(out, v); }
+        static void get(const uint8_t *in, uint32_t *v) { *v = aRibeiro::BinaryEndian::load32(in); }
+    };
+
+    template <>
+    struct ModelFieldPOD<int32_t> {
+        static const size_t Size = 4;
+        static const char* tag() { return "i32"; }
+        static void put(uint8_t *out, const int32_t &v) { aRibeiro::BinaryEndian::store32(out, (uint32_t)v); }
+        static void get(const uint8_t *in, int32_t *v) { *v = (int32_t)aRibeiro::BinaryEndian::load32(in); }
+    };
+
+    template <>
+    struct ModelFieldPOD<float> {
+        static const size_t Size = 4;
+        static const char* tag() { return "f32"; }
+        static void put(uint8_t *out, const float &v) {
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof(uint32_t));
+            aRibeiro::BinaryEndian::store32(out, bits);
+        }
+        static void get(const uint8_t *in, float *v) {
+            uint32_t bits = aRibeiro::BinaryEndian::load32(in);
+            memcpy(v, &bits, sizeof(uint32_t));
+        }
+    };
+
+    template <>
+    struct ModelFieldPOD<aRibeiro::vec2> {
+        static const size_t Size = 8;
+        static const char* tag() { return "vec2"; }
+        static void put(uint8_t *out, const aRibeiro::vec2 &v) {
+            ModelFieldPOD<float>::put(out, v.x);
+            ModelFieldPOD<float>::put(out + 4, v.y);
+        }
+        static void get(const uint8_t *in, aRibeiro::vec2 *v) {
+            ModelFieldPOD<float>::get(in, &v->x);
+            ModelFieldPOD<float>::get(in + 4, &v->y);
+        }
+    };
+
+    template <>
+    struct ModelFieldPOD<aRibeiro::vec3> {
+        static const size_t Size = 12;
+        static const char* tag() { return "vec3"; }
+        static void put(uint8_t *out, const aRibeiro::vec3 &v) {
+            ModelFieldPOD<float>::put(out, v.x);
+            ModelFieldPOD<float>::put(out + 4, v.y);
+            ModelFieldPOD<float>::put(out + 8, v.z);
+        }
+        static void get(const uint8_t *in, aRibeiro::vec3 *v) {
+            ModelFieldPOD<float>::get(in, &v->x);
+            ModelFieldPOD<float>::get(in + 4, &v->y);
+            ModelFieldPOD<float>::get(in + 8, &v->z);
+        }
+    };
+
+    template <>
+    struct ModelFieldPOD<aRibeiro::vec4> {
+        static const size_t Size = 16;
+        static const char* tag() { return "vec4"; }
+        static void put(uint8_t *out, const aRibeiro::vec4 &v) {
+            ModelFieldPOD<float>::put(out, v.x);
+            ModelFieldPOD<float>::put(out + 4, v.y);
+            ModelFieldPOD<float>::put(out + 8, v.z);
+            ModelFieldPOD<float>::put(out + 12, v.w);
+        }
+        static void get(const uint8_t *in, aRibeiro::vec4 *v) {
+            ModelFieldPOD<float>::get(in, &v->x);
+            ModelFieldPOD<float>::get(in + 4, &v->y);
+            ModelFieldPOD<float>::get(in + 8, &v->z);
+            ModelFieldPOD<float>::get(in + 12, &v->w);
+        }
+    };
+
+    template <>
+    struct ModelFieldPOD<aRibeiro::quat> {
+        static const size_t Size = 16;
+        static const char* tag() { return "quat"; }
+        static void put(uint8_t *out, const aRibeiro::quat &v) {
+            ModelFieldPOD<float>::put(out, v.x);
+            ModelFieldPOD<float>::put(out + 4, v.y);
+            ModelFieldPOD<float>::put(out + 8, v.z);
+            ModelFieldPOD<float>::put(out + 12, v.w);
+        }
+        static void get(const uint8_t *in, aRibeiro::quat *v) {
+            ModelFieldPOD<float>::get(in, &v->x);
+            ModelFieldPOD<float>::get(in + 4, &v->y);
+            ModelFieldPOD<float>::get(in + 8, &v->z);
+            ModelFieldPOD<float>::get(in + 12, &v->w);
+        }
+    };
+
+    template <>
+    struct ModelFieldPOD<aRibeiro::mat4> {
+        static const size_t Size = 64;
+        static const char* tag() { return "mat4"; }
+        static void put(uint8_t *out, const aRibeiro::mat4 &v) {
+            for (int i = 0; i < 4; i++)
+                ModelFieldPOD<aRibeiro::vec4>::put(out + i * 16, v[i]);
+        }
+        static void get(const uint8_t *in, aRibeiro::mat4 *v) {
+            for (int i = 0; i < 4; i++)
+                ModelFieldPOD<aRibeiro::vec4>::get(in + i * 16, &(*v)[i]);
+        }
+    };
+
+    //
+    // computes the pod run sizes of a field list (the reader needs them before the first pod of each run)
+    //
+    class ModelFieldRuns {
+        bool open;
+    public:
+        uint32_t revision;
+        size_t sizes[ModelFields_MaxRuns];
+        size_t count;
+        // the object has pod fields only: its stream is the concatenation of the runs
+        bool podOnly;
+
+        ModelFieldRuns(uint32_t revision) {
+            this->revision = revision;
+            open = false;
+            count = 0;
+            podOnly = true;
+        }
+
+        size_t totalSize()const {
+            size_t total = 0;
+            for (size_t i = 0; i < count; i++)
+                total += sizes[i];
+            return total;
+        }
+
+        void close() {
+            open = false;
+            podOnly = false;
+        }
+
+        void add(size_t size) {
+            if (!open || sizes[count - 1] + size > ModelFields_RunSize) {
+                ARIBEIRO_ABORT(count == ModelFields_MaxRuns, "Too many pod runs in the field list.\n");
+                sizes[count++] = 0;
+                open = true;
+            }
+            sizes[count - 1] += size;
+        }
+
+        template <typename T>
+        void pod(const char*, const T &) { add(ModelFieldPOD<T>::Size); }
+        template <typename E>
+        void enum8(const char*, const E &) { add(1); }
+        template <typename T>
+        void object(const char*, T &v) { v.fields(*this); }
+
+        void name(const char*, const std::string &) { close(); }
+        void varuint(const char*, const uint32_t &) { close(); }
+        template <typename A>
+        void array(const char*, const A &) { close(); }
+        void deltaArray(const char*, const std::vector<uint32_t> &) { close(); }
+        void indices(const char*, const std::vector<uint32_t> &) { close(); }
+        void indices16(const char*, const std::vector<uint32_t> &) { close(); }
+        template <typename T>
+        void objects(const char*, const aRibeiro::aligned_vector<T> &) { close(); }
+        template <typename M, typename W, typename R>
+        void map(const char*, const M &, void (aRibeiro::BinaryWriter::*)(W), R(aRibeiro::BinaryReader::*)()) { close(); }
+        template <typename T>
+        void custom(const char*, uint32_t, T &, void (T::*)(aRibeiro::BinaryWriter*)const, void (T::*)(aRibeiro::BinaryReader*)) { close(); }
+        template <typename T>
+        void readReset(const char*, T &, void (T::*)()) {}
+    };
+
+    //
+    // decodes the pod fields of an object from memory (the objects with pod fields only)
+    //
+    class ModelFieldDecoder {
+        const uint8_t *in;
+    public:
+        uint32_t revision;
+
+        ModelFieldDecoder(uint32_t revision, const uint8_t *in) {
+            this->revision = revision;
+            this->in = in;
+        }
+
+        template <typename T>
+        void pod(const char*, T &v) {
+            ModelFieldPOD<T>::get(in, &v);
+            in += ModelFieldPOD<T>::Size;
+        }
+        template <typename E>
+        void enum8(const char*, E &v) {
+            v = (E)*in;
+            in++;
+        }
+        template <typename T>
+        void object(const char*, T &v) { v.fields(*this); }
+
+        // not visited: the runs of the object are pod only
+        void name(const char*, const std::string &) {}
+        void varuint(const char*, const uint32_t &) {}
+        template <typename A>
+        void array(const char*, const A &) {}
+        void deltaArray(const char*, const std::vector<uint32_t> &) {}
+        void indices(const char*, const std::vector<uint32_t> &) {}
+        void indices16(const char*, const std::vector<uint32_t> &) {}
+        template <typename T>
+        void objects(const char*, const aRibeiro::aligned_vector<T> &) {}
+        template <typename M, typename W, typename R>
+        void map(const char*, const M &, void (aRibeiro::BinaryWriter::*)(W), R(aRibeiro::BinaryReader::*)()) {}
+        template <typename T>
+        void custom(const char*, uint32_t, T &, void (T::*)(aRibeiro::BinaryWriter*)const, void (T::*)(aRibeiro::BinaryReader*)) {}
+
+        template <typename T>
+        void readReset(const char*, T &obj, void (T::*resetFn)()) {
+            (obj.*resetFn)();
+        }
+    };
+
+    template <typename T>
+    void ModelFields_ReadObjects(aRibeiro::BinaryReader* reader, aRibeiro::aligned_vector<T> *v);
+
+    //
+    // writer visitor
+    //
+    class ModelFieldWriter {
+        aRibeiro::BinaryWriter* writer;
+        uint8_t run[ModelFields_RunSize];
+        size_t runSize;
+    public:
+        uint32_t revision;
+
+        ModelFieldWriter(aRibeiro::BinaryWriter* writer) {
+            this->writer = writer;
+            revision = writer->revision;
+            runSize = 0;
+        }
+
+        void flush() {
+            if (runSize > 0)
+                writer->write(run, runSize);
+            runSize = 0;
+        }
+
+        template <typename T>
+        void pod(const char*, const T &v) {
+            if (runSize + ModelFieldPOD<T>::Size > ModelFields_RunSize)
+                flush();
+            ModelFieldPOD<T>::put(&run[runSize], v);
+            runSize += ModelFieldPOD<T>::Size;
+        }
+
+        template <typename E>
+        void enum8(const char* id, const E &v) {
+            uint8_t value = (uint8_t)v;
+            pod(id, value);
+        }
+
+        template <typename T>
+        void object(const char*, T &v) {
+            v.fields(*this);
+        }
+
+        void name(const char*, const std::string &v) {
+            flush();
+            ModelRevision_WriteName(writer, v);
+        }
+
+        void varuint(const char*, const uint32_t &v) {
+            flush();
+            writer->writeVarUInt32(v);
+        }
+
+        void array(const char*, const std::vector<float> &v) { flush(); writer->writeVectorFloat(v); }
+        void array(const char*, const std::vector<uint16_t> &v) { flush(); writer->writeVectorUInt16(v); }
+        void array(const char*, const std::vector<uint32_t> &v) { flush(); writer->writeVectorUInt32(v); }
+        void array(const char*, const aRibeiro::aligned_vector<aRibeiro::vec2> &v) { flush(); writer->writeVectorVec2(v); }
+        void array(const char*, const aRibeiro::aligned_vector<aRibeiro::vec3> &v) { flush(); writer->writeVectorVec3(v); }
+        void array(const char*, const aRibeiro::aligned_vector<aRibeiro::vec4> &v) { flush(); writer->writeVectorVec4(v); }
+
+        void deltaArray(const char*, const std::vector<uint32_t> &v) {
+            flush();
+            writer->writeVectorUInt32Delta(v);
+        }
+
+        // index array with the smallest width, or delta coded (see IndexBuffer.h)
+        void indices(const char*, const std::vector<uint32_t> &v) {
+            flush();
+            IndexBuffer_Write(writer, v);
+        }
+
+        // index array in the uint16 array layout
+        void indices16(const char*, const std::vector<uint32_t> &v) {
+            flush();
+            IndexBuffer_Write16(writer, v);
+        }
+
+        template <typename T>
+        void objects(const char*, const aRibeiro::aligned_vector<T> &v) {
+            flush();
+            aRibeiro::BinaryWriter_WriteAlignedVector<T>(writer, v);
+        }
+
+        template <typename M, typename W, typename R>
+        void map(const char*, const M &v, void (aRibeiro::BinaryWriter::*writeValue)(W), R(aRibeiro::BinaryReader::*)()) {
+            flush();
+            if (revision >= ModelRevision_StringTable) {
+                ModelRevision_WriteNameMap(writer, v, writeValue);
+                return;
+            }
+            // the BinaryWriter::writeStringMap* layout
+            writer->writeUInt32((uint32_t)v.size());
+            for (typename M::const_iterator it = v.begin(); it != v.end(); it++) {
+                writer->writeString(it->first);
+                (writer->*writeValue)(it->second);
+            }
+        }
+
+        template <typename T>
+        void custom(const char*, uint32_t, T &obj, void (T::*writeFn)(aRibeiro::BinaryWriter*)const, void (T::*)(aRibeiro::BinaryReader*)) {
+            flush();
+            (obj.*writeFn)(writer);
+        }
+
+        template <typename T>
+        void readReset(const char*, T &, void (T::*)()) {}
+    };
+
+    //
+    // reader visitor
+    //
+    class ModelFieldReader {
+        aRibeiro::BinaryReader* reader;
+        const ModelFieldRuns &runs;
+        size_t runIndex;
+        uint8_t run[ModelFields_RunSize];
+        size_t runPos;
+        size_t runLeft;
+
+        // one read call for the whole run
+        void fetch() {
+            size_t size = runs.sizes[runIndex++];
+            reader->read(run, (int)size);
+            runPos = 0;
+            runLeft = size;
+        }
+
+    public:
+        uint32_t revision;
+
+        ModelFieldReader(aRibeiro::BinaryReader* reader, const ModelFieldRuns &_runs) :runs(_runs) {
+            this->reader = reader;
+            revision = reader->revision;
+            runIndex = 0;
+            runPos = 0;
+            runLeft = 0;
+        }
+
+        template <typename T>
+        void pod(const char*, T &v) {
+            if (runLeft == 0)
+                fetch();
+            ModelFieldPOD<T>::get(&run[runPos], &v);
+            runPos += ModelFieldPOD<T>::Size;
+            runLeft -= ModelFieldPOD<T>::Size;
+        }
+
+        template <typename E>
+        void enum8(const char* id, E &v) {
+            uint8_t value;
+            pod(id, value);
+            v = (E)value;
+        }
+
+        template <typename T>
+        void object(const char*, T &v) {
+            v.fields(*this);
+        }
+
+        void name(const char*, std::string &v) {
+            ModelRevision_ReadName(reader, &v);
+        }
+
+        void varuint(const char*, uint32_t &v) {
+            v = reader->readVarUInt32();
+        }
+
+        void array(const char*, std::vector<float> &v) { reader->readVectorFloat(&v); }
+        void array(const char*, std::vector<uint16_t> &v) { reader->readVectorUInt16(&v); }
+        void array(const char*, std::vector<uint32_t> &v) { reader->readVectorUInt32(&v); }
+        void array(const char*, aRibeiro::aligned_vector<aRibeiro::vec2> &v) { reader->readVectorVec2(&v); }
+        void array(const char*, aRibeiro::aligned_vector<aRibeiro::vec3> &v) { reader->readVectorVec3(&v); }
+        void array(const char*, aRibeiro::aligned_vector<aRibeiro::vec4> &v) { reader->readVectorVec4(&v); }
+
+        void deltaArray(const char*, std::vector<uint32_t> &v) {
+            reader->readVectorUInt32Delta(&v);
+        }
+
+        void indices(const char*, std::vector<uint32_t> &v) {
+            IndexBuffer_Read(reader, &v);
+        }
+
+        void indices16(const char*, std::vector<uint32_t> &v) {
+            IndexBuffer_Read16(reader, &v);
+        }
+
+        template <typename T>
+        void objects(const char*, aRibeiro::aligned_vector<T> &v) {
+            ModelFields_ReadObjects(reader, &v);
+        }
+
+        template <typename M, typename W, typename R>
+        void map(const char*, M &v, void (aRibeiro::BinaryWriter::*)(W), R(aRibeiro::BinaryReader::*readValue)()) {
+            if (revision >= ModelRevision_StringTable) {
+                ModelRevision_ReadNameMap(reader, &v, readValue);
+                return;
+            }
+            // the BinaryReader::readStringMap* layout
+            v.clear();
+            // each entry has at least the string size and 1 byte for the value
+            uint32_t size = reader->validateCount(reader->readUInt32(), sizeof(uint16_t) + 1);
+            for (uint32_t i = 0; i < size; i++) {
+                std::string key = reader->readString();
+                v[key] = (reader->*readValue)();
+            }
+        }
+
+        template <typename T>
+        void custom(const char*, uint32_t, T &obj, void (T::*)(aRibeiro::BinaryWriter*)const, void (T::*readFn)(aRibeiro::BinaryReader*)) {
+            (obj.*readFn)(reader);
+        }
+
+        template <typename T>
+        void readReset(const char*, T &obj, void (T::*resetFn)()) {
+            (obj.*resetFn)();
+        }
+    };
+
+    //
+    // schema hash visitor: FNV-1a of the field kinds, types and ids (nested objects included)
+    //
+    class ModelFieldHash {
+    public:
+        uint32_t revision;
+        uint32_t hash;
+
+        ModelFieldHash(uint32_t revision) {
+            this->revision = revision;
+            hash = 2166136261u;
+            mix(revision);
+        }
+
+        void mix(uint32_t v) {
+            for (int i = 0; i < 4; i++) {
+                hash ^= (v >> (i * 8)) & 0xff;
+                hash *= 16777619u;
+            }
+        }
+
+        void mix(const char* kind, const char* id) {
+            for (const char* c = kind; *c != 0; c++) {
+                hash ^= (uint8_t)*c;
+                hash *= 16777619u;
+            }
+            hash ^= ':';
+            hash *= 16777619u;
+            for (const char* c = id; *c != 0; c++) {
+                hash ^= (uint8_t)*c;
+                hash *= 16777619u;
+            }
+            hash ^= ';';
+            hash *= 16777619u;
+        }
+
+        template <typename T>
+        void pod(const char* id, const T &) { mix(ModelFieldPOD<T>::tag(), id); }
+        template <typename E>
+        void enum8(const char* id, const E &) { mix("enum8", id); }
+        template <typename T>
+        void object(const char* id, T &v) {
+            mix("object", id);
+            v.fields(*this);
+            mix("end", id);
+        }
+
+        void name(const char* id, const std::string &) { mix("name", id); }
+        void varuint(const char* id, const uint32_t &) { mix("varuint", id); }
+
+        void array(const char* id, const std::vector<float> &) { mix("f32[]", id); }
+        void array(const char* id, const std::vector<uint16_t> &) { mix("u16[]", id); }
+        void array(const char* id, const std::vector<uint32_t> &) { mix("u32[]", id); }
+        void array(const char* id, const aRibeiro::aligned_vector<aRibeiro::vec2> &) { mix("vec2[]", id); }
+        void array(const char* id, const aRibeiro::aligned_vector<aRibeiro::vec3> &) { mix("vec3[]", id); }
+        void array(const char* id, const aRibeiro::aligned_vector<aRibeiro::vec4> &) { mix("vec4[]", id); }
+        void deltaArray(const char* id, const std::vector<uint32_t> &) { mix("delta[]", id); }
+        void indices(const char* id, const std::vector<uint32_t> &) { mix("indices", id); }
+        // the same stream layout as the uint16 array
+        void indices16(const char* id, const std::vector<uint32_t> &) { mix("u16[]", id); }
+
+        template <typename T>
+        void objects(const char* id, const aRibeiro::aligned_vector<T> &) {
+            mix("objects", id);
+            T element;
+            element.fields(*this);
+            mix("end", id);
+        }
+
+        template <typename M, typename W, typename R>
+        void map(const char* id, const M &, void (aRibeiro::BinaryWriter::*)(W), R(aRibeiro::BinaryReader::*)()) {
+            mix("map", id);
+        }
+
+        template <typename T>
+        void custom(const char* id, uint32_t layout, T &, void (T::*)(aRibeiro::BinaryWriter*)const, void (T::*)(aRibeiro::BinaryReader*)) {
+            mix("custom", id);
+            mix(layout);
+        }
+
+        // no stream data: the layout does not change
+        template <typename T>
+        void readReset(const char*, T &, void (T::*)()) {}
+    };
+
+    template <typename T>
+    void ModelFields_Write(aRibeiro::BinaryWriter* writer, const T &obj) {
+        ModelFieldWriter visitor(writer);
+        // the field list is shared with the reader, it does not change the object
+        const_cast<T&>(obj).fields(visitor);
+        visitor.flush();
+    }
+
+    template <typename T>
+    void ModelFields_Read(aRibeiro::BinaryReader* reader, T *obj) {
+        ModelFieldRuns runs(reader->revision);
+        obj->fields(runs);
+        ModelFieldReader visitor(reader, runs);
+        obj->fields(visitor);
+    }
+
+    // The same layout as the BinaryReader_ReadAlignedVector of the read method.
+    //
+    // The field list does not depend on the values, so the pod runs are computed once
+    // for the whole array. The arrays of pod only objects (the animation keys, and the
+    // vertex weights before the varint revision) are read in blocks of elements:
+    // one read call for each block.
+    template <typename T>
+    void ModelFields_ReadObjects(aRibeiro::BinaryReader* reader, aRibeiro::aligned_vector<T> *v) {
+        uint32_t count = reader->readUInt32();
+
+        ModelFieldRuns runs(reader->revision);
+        T element;
+        element.fields(runs);
+
+        uint8_t block[ModelFields_RunSize * 16];
+        size_t stride = runs.totalSize();
+        if (!runs.podOnly || stride == 0 || stride > sizeof(block)) {
+            v->resize(reader->validateCount(count, 1));
+            for (size_t i = 0; i < v->size(); i++) {
+                ModelFieldReader visitor(reader, runs);
+                (*v)[i].fields(visitor);
+            }
+            return;
+        }
+
+        v->resize(reader->validateCount(count, stride));
+        size_t blockCount = sizeof(block) / stride;
+        for (size_t i = 0; i < v->size(); i += blockCount) {
+            size_t n = v->size() - i;
+            if (n > blockCount)
+                n = blockCount;
+            reader->read(block, (int)(n * stride));
+            for (size_t j = 0; j < n; j++) {
+                ModelFieldDecoder decoder(reader->revision, &block[j * stride]);
+                (*v)[i + j].fields(decoder);
+            }
+        }
+    }
+
+    // hash of the stream layout of a class in a revision
+    template <typename T>
+    uint32_t ModelFields_SchemaHash(uint32_t revision) {
+        ModelFieldHash visitor(revision);
+        T obj;
+        obj.fields(visitor);
+        return visitor.hash;
+    }
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef model_model_revision_h_
+#define model_model_revision_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <aRibeiroData/BinaryReader.h>
+#include <aRibeiroData/BinaryWriter.h>
+
+namespace model {
+
+    // Layout revision of the data-model classes.
+    //
+    // The ModelContainer writes the revision in the stream header and sets it
+    // in the BinaryWriter/BinaryReader, so each class selects its layout from
+    // writer->revision / reader->revision.
+    //
+    // Streams without the header are the legacy layout (revision 0).
+
+    const uint32_t ModelRevision_Legacy = 0; // fixed width integers
+    const uint32_t ModelRevision_Varint = 1; // varint integers and delta coded index lists
+    const uint32_t ModelRevision_StringTable = 2; // names and material keys through the stream string table
+    const uint32_t ModelRevision_SchemaHash = 3; // field list hash in the container header (see ModelFields.h)
+    const uint32_t ModelRevision_Channels = 4; // geometry: only the uv and color channels in the format, uv with 2 components
+    const uint32_t ModelRevision_Indices = 5; // geometry: 32 bits indices with the smallest width or delta coded (see IndexBuffer.h)
+    const uint32_t ModelRevision_Quantized = 6; // geometry: quantization flags and the quantized attributes (see GeometryQuantization.h)
+
+    const uint32_t ModelRevision_Current = ModelRevision_Quantized;
+
+    // names: written once in the stream string table, and referenced by index after that
+    static inline void ModelRevision_WriteName(aRibeiro::BinaryWriter* writer, const std::string &name) {
+        if (writer->revision >= ModelRevision_StringTable)
+            writer->writeStringRef(name);
+        else
+            writer->writeString(name);
+    }
+
+    static inline void ModelRevision_ReadName(aRibeiro::BinaryReader* reader, std::string *name) {
+        if (reader->revision >= ModelRevision_StringTable)
+            *name = reader->readStringRef();
+        else
+            *name = reader->readString();
+    }
+
+    // string maps with the keys in the string table.
+    // The older revisions use the BinaryWriter/BinaryReader string map methods.
+    template <typename M, typename V>
+    void ModelRevision_WriteNameMap(aRibeiro::BinaryWriter* writer, const M &map, void (aRibeiro::BinaryWriter::*writeValue)(V)) {
+        writer->writeVarUInt32((uint32_t)map.size());
+        for (typename M::const_iterator it = map.begin(); it != map.end(); it++) {
+            writer->writeStringRef(it->first);
+            (writer->*writeValue)(it->second);
+        }
+    }
+
+    template <typename M, typename V>
+    void ModelRevision_ReadNameMap(aRibeiro::BinaryReader* reader, M *map, V (aRibeiro::BinaryReader::*readValue)()) {
+        map->clear();
+        // each entry has at least 1 byte for the key and 1 byte for the value
+        uint32_t size = reader->validateCount(reader->readVarUInt32(), 2);
+        for (uint32_t i = 0; i < size; i++) {
+            const std::string &key = reader->readStringRef();
+            (*map)[key] = (reader->*readValue)();
+        }
+    }
+
+}
+
+#endif
@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE Node {
@@ -16,20 +18,27 @@ namespace model {
         std::vector<uint32_t> children;
         aRibeiro::mat4 transform;
 
+        template <typename V>
+        void fields(V &v) {
+            v.name("name", name);
+            v.pod("transform", transform);
+            if (v.revision >= ModelRevision_Varint) {
+                v.deltaArray("geometries", geometries);
+                v.deltaArray("children", children);
+            } else {
+                v.array("geometries", geometries);
+                v.array("children", children);
+            }
+        }
+
         void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeString(name);
-            writer->writeMat4(transform);
-            writer->writeVectorUInt32(geometries);
-            writer->writeVectorUInt32(children);
+            ModelFields_Write(writer, *this);
         }
 
         void read(aRibeiro::BinaryReader* reader) {
-            name = reader->readString();
-            transform = reader->readMat4();
-            reader->readVectorUInt32(&geometries);
-            reader->readVectorUInt32(&children);
+            ModelFields_Read(reader, this);
         }
-
+        
         Node() {
 
         }
@@ -10,6 +10,8 @@
 #include "Vec3Key.h"
 #include "QuatKey.h"
 
+#include "ModelFields.h"
+
 namespace model {
 
     // Defines how an animation channel behaves outside the defined time range.
@@ -37,24 +39,23 @@ namespace model {
         AnimBehaviour preState;
         AnimBehaviour postState;
 
-        void write(aRibeiro::BinaryWriter* writer) const{
-            writer->writeString(nodeName);
-            writer->writeUInt8(preState);
-            writer->writeUInt8(postState);
+        template <typename V>
+        void fields(V &v) {
+            v.name("nodeName", nodeName);
+            v.enum8("preState", preState);
+            v.enum8("postState", postState);
             
-            aRibeiro::BinaryWriter_WriteAlignedVector<Vec3Key>(writer,positionKeys);
-            aRibeiro::BinaryWriter_WriteAlignedVector<QuatKey>(writer,rotationKeys);
-            aRibeiro::BinaryWriter_WriteAlignedVector<Vec3Key>(writer,scalingKeys);
+            v.objects("positionKeys", positionKeys);
+            v.objects("rotationKeys", rotationKeys);
+            v.objects("scalingKeys", scalingKeys);
+        }
+
+        void write(aRibeiro::BinaryWriter* writer)const {
+            ModelFields_Write(writer, *this);
         }
 
         void read(aRibeiro::BinaryReader* reader) {
-            nodeName = reader->readString();
-            preState = (AnimBehaviour)(reader->readUInt8());
-            postState = (AnimBehaviour)(reader->readUInt8());
-            
-            aRibeiro::BinaryReader_ReadAlignedVector<Vec3Key>(reader,&positionKeys);
-            aRibeiro::BinaryReader_ReadAlignedVector<QuatKey>(reader,&rotationKeys);
-            aRibeiro::BinaryReader_ReadAlignedVector<Vec3Key>(reader,&scalingKeys);
+            ModelFields_Read(reader, this);
         }
         
         NodeAnimation() {
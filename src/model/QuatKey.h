@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE QuatKey{
@@ -14,14 +16,18 @@ namespace model {
         float time;
         aRibeiro::quat value;
         
+        template <typename V>
+        void fields(V &v) {
+            v.pod("time", time);
+            v.pod("value", value);
+        }
+
         void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeFloat(time);
-            writer->writeQuat(value);
+            ModelFields_Write(writer, *this);
         }
         
         void read(aRibeiro::BinaryReader* reader) {
-            time = reader->readFloat();
-            value = reader->readQuat();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
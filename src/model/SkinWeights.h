@@ -0,0 +1,278 @@
+#ifndef model_skin_weights_h_
+#define model_skin_weights_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "Geometry.h"
+#include "GeometryQuantization.h"
+
+namespace model {
+
+    // Vertex major bone weights for the CPU skinning.
+    //
+    // The Bone::weights are bone major: each bone has the list of the vertices it moves.
+    // The SkinWeights keeps the influences of each vertex together, with a fixed count
+    // of influences per vertex (4 or 8):
+    //
+    //   boneIndex8 or boneIndex16: vertexCount x influences bone indices (8 bits with up to 256 bones)
+    //   weights: vertexCount x influences unorm16 weights, the sum of each vertex is 65535
+    //
+    // The influences of a vertex are sorted by weight (the greatest first). The vertices with
+    // more influences keep the greatest ones, normalized. The unused slots have the weight 0.
+    //
+    // The skin deforms the pos and normals with the blend of the bone matrices (linear blend skinning),
+    // in parallel (OpenMP) and with SSE2. The vertices without influences are copied.
+    //
+    // Example:
+    //
+    //   model::SkinWeights skin;
+    //   skin.build(geometry, 4);
+    //
+    //   // for each geometry bone: bone world matrix * bone bind pose inverse
+    //   aRibeiro::aligned_vector<aRibeiro::mat4> matrices;
+    //   matrices.resize(geometry.bones.size());
+    //   ...
+    //   skin.skin(geometry, &matrices[0], &skinnedPos, &skinnedNormals);
+    //
+
+    class _SSE2_ALIGN_PRE SkinWeights {
+
+        struct Influence {
+            uint32_t bone;
+            float weight;
+            bool operator<(const Influence &v)const {
+                // greatest weight first, the bone order on ties
+                return (weight > v.weight) || (weight == v.weight && bone < v.bone);
+            }
+        };
+
+#if defined(ARIBEIRO_SSE2)
+        static __m128 loadVec3(const aRibeiro::vec3 &v) {
+            if (sizeof(aRibeiro::vec3) == 16)
+                return _mm_loadu_ps((const float *)&v);
+            return _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+        }
+#endif
+
+        // the vertices [first..last)
+        template <typename I>
+        void skinRange(const I *boneIndex, const aRibeiro::mat4 *matrices,
+                       const aRibeiro::vec3 *pos, const aRibeiro::vec3 *normals,
+                       aRibeiro::vec3 *outPos, aRibeiro::vec3 *outNormals, int first, int last)const {
+            const uint16_t *weight = &weights[0];
+            for (int v = first; v < last; v++) {
+                const I *vertexBone = boneIndex + (size_t)v * influences;
+                const uint16_t *vertexWeight = weight + (size_t)v * influences;
+                if (vertexWeight[0] == 0) {
+                    // no influences
+                    if (outPos != NULL)
+                        outPos[v] = pos[v];
+                    if (outNormals != NULL)
+                        outNormals[v] = normals[v];
+                    continue;
+                }
+#if defined(ARIBEIRO_SSE2)
+                // blend of the matrix columns
+                __m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+                for (uint32_t k = 0; k < influences && vertexWeight[k] != 0; k++) {
+                    const float *m = (const float *)&matrices[vertexBone[k]];
+                    __m128 w = _mm_set1_ps((float)vertexWeight[k] * (1.0f / 65535.0f));
+                    c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m), w));
+                    c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+                    c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+                    c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+                }
+                if (outPos != NULL) {
+                    __m128 p = loadVec3(pos[v]);
+                    __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))),
+                                                     _mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)))),
+                                          _mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))), c3));
+                    GeometryQuantization::storeVec3(&outPos[v], r);
+                }
+                if (outNormals != NULL) {
+                    __m128 n = loadVec3(normals[v]);
+                    __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 0, 0, 0))),
+                                                     _mm_mul_ps(c1, _mm_shuffle_ps(n, n, _MM_SHUFFLE(1, 1, 1, 1)))),
+                                          _mm_mul_ps(c2, _mm_shuffle_ps(n, n, _MM_SHUFFLE(2, 2, 2, 2))));
+                    // normalize xyz
+                    __m128 sq = _mm_mul_ps(r, r);
+                    __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(0, 0, 0, 0)),
+                                                           _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))),
+                                                _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+                    __m128 length = _mm_sqrt_ps(length2);
+                    __m128 nonZero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+                    r = _mm_and_ps(_mm_div_ps(r, length), nonZero);
+                    GeometryQuantization::storeVec3(&outNormals[v], r);
+                }
+#else
+                float m[16] = { 0 };
+                for (uint32_t k = 0; k < influences && vertexWeight[k] != 0; k++) {
+                    const float *bone = (const float *)&matrices[vertexBone[k]];
+                    float w = (float)vertexWeight[k] * (1.0f / 65535.0f);
+                    for (int i = 0; i < 16; i++)
+                        m[i] += bone[i] * w;
+                }
+                if (outPos != NULL) {
+                    const aRibeiro::vec3 &p = pos[v];
+                    outPos[v] = aRibeiro::vec3(m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+                                               m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+                                               m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]);
+                }
+                if (outNormals != NULL) {
+                    const aRibeiro::vec3 &n = normals[v];
+                    aRibeiro::vec3 r(m[0] * n.x + m[4] * n.y + m[8] * n.z,
+                                     m[1] * n.x + m[5] * n.y + m[9] * n.z,
+                                     m[2] * n.x + m[6] * n.y + m[10] * n.z);
+                    float length = sqrtf(r.x * r.x + r.y * r.y + r.z * r.z);
+                    outNormals[v] = (length > 0.0f) ? r * (1.0f / length) : aRibeiro::vec3(0);
+                }
+#endif
+            }
+        }
+
+    public:
+
+        uint32_t vertexCount;
+        uint32_t influences; // per vertex: 4 or 8
+        uint32_t boneCount;
+        uint32_t indexSize; // 1: boneIndex8, 2: boneIndex16
+
+        std::vector<uint8_t> boneIndex8;
+        std::vector<uint16_t> boneIndex16;
+        std::vector<uint16_t> weights;
+
+        SkinWeights() {
+            vertexCount = 0;
+            influences = 4;
+            boneCount = 0;
+            indexSize = 1;
+        }
+
+        // the influences of the geometry bones, 4 or 8 per vertex
+        void build(const Geometry &geometry, uint32_t influences = 4) {
+            ARIBEIRO_ABORT(influences != 4 && influences != 8, "SkinWeights: the influences per vertex must be 4 or 8.\n");
+            ARIBEIRO_ABORT(geometry.bones.size() > 0x10000, "SkinWeights: more than 65536 bones.\n");
+
+            this->vertexCount = geometry.vertexCount;
+            this->influences = influences;
+            boneCount = (uint32_t)geometry.bones.size();
+            indexSize = (boneCount <= 0x100) ? 1 : 2;
+
+            // the bone major weights to a list per vertex (counting sort)
+            std::vector<uint32_t> offset(vertexCount + 1, 0);
+            for (size_t b = 0; b < geometry.bones.size(); b++) {
+                const aRibeiro::aligned_vector<VertexWeight> &boneWeights = geometry.bones[b].weights;
+                for (size_t i = 0; i < boneWeights.size(); i++)
+                    if (boneWeights[i].vertexID < vertexCount && boneWeights[i].weight > 0.0f)
+                        offset[boneWeights[i].vertexID + 1]++;
+            }
+            for (uint32_t v = 0; v < vertexCount; v++)
+                offset[v + 1] += offset[v];
+
+            std::vector<Influence> list(offset[vertexCount]);
+            std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+            for (size_t b = 0; b < geometry.bones.size(); b++) {
+                const aRibeiro::aligned_vector<VertexWeight> &boneWeights = geometry.bones[b].weights;
+                for (size_t i = 0; i < boneWeights.size(); i++) {
+                    const VertexWeight &vw = boneWeights[i];
+                    if (vw.vertexID < vertexCount && vw.weight > 0.0f) {
+                        Influence &influence = list[fill[vw.vertexID]++];
+                        influence.bone = (uint32_t)b;
+                        influence.weight = vw.weight;
+                    }
+                }
+            }
+
+            weights.assign((size_t)vertexCount * influences, 0);
+            boneIndex8.clear();
+            boneIndex16.clear();
+            if (indexSize == 1)
+                boneIndex8.assign((size_t)vertexCount * influences, 0);
+            else
+                boneIndex16.assign((size_t)vertexCount * influences, 0);
+
+            // the greatest influences of each vertex, normalized to unorm16
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) if (vertexCount > 4096)
+#endif
+            for (int v = 0; v < (int)vertexCount; v++) {
+                if (offset[v] == offset[v + 1])
+                    continue;
+                Influence *first = &list[offset[v]];
+                Influence *last = first + (offset[v + 1] - offset[v]);
+                uint32_t count = (uint32_t)(last - first);
+                if (count > influences) {
+                    std::partial_sort(first, first + influences, last);
+                    count = influences;
+                } else
+                    std::sort(first, last);
+
+                float sum = 0.0f;
+                for (uint32_t k = 0; k < count; k++)
+                    sum += first[k].weight;
+
+                uint16_t *vertexWeight = &weights[(size_t)v * influences];
+                uint32_t total = 0;
+                for (uint32_t k = 0; k < count; k++) {
+                    vertexWeight[k] = (uint16_t)GeometryQuantization::floatToNorm(first[k].weight / sum, 0.0f, 65535.0f);
+                    total += vertexWeight[k];
+                    if (indexSize == 1)
+                        boneIndex8[(size_t)v * influences + k] = (uint8_t)first[k].bone;
+                    else
+                        boneIndex16[(size_t)v * influences + k] = (uint16_t)first[k].bone;
+                }
+                // the rounding error to the greatest weight: the sum is exactly 65535
+                vertexWeight[0] = (uint16_t)(vertexWeight[0] + 65535 - (int32_t)total);
+            }
+        }
+
+        // pos and normals of the geometry deformed by one matrix per geometry bone
+        // (bone world matrix * bone bind pose inverse)
+        void skin(const aRibeiro::vec3 *pos, const aRibeiro::vec3 *normals, const aRibeiro::mat4 *matrices,
+                  aRibeiro::vec3 *outPos, aRibeiro::vec3 *outNormals)const {
+            if (pos == NULL)
+                outPos = NULL;
+            if (normals == NULL)
+                outNormals = NULL;
+            if (vertexCount == 0 || (outPos == NULL && outNormals == NULL))
+                return;
+            const int blockSize = 1024;
+            int blockCount = (int)((vertexCount + blockSize - 1) / blockSize);
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) if (blockCount > 4)
+#endif
+            for (int block = 0; block < blockCount; block++) {
+                int first = block * blockSize;
+                int last = (first + blockSize < (int)vertexCount) ? first + blockSize : (int)vertexCount;
+                if (indexSize == 1)
+                    skinRange(&boneIndex8[0], matrices, pos, normals, outPos, outNormals, first, last);
+                else
+                    skinRange(&boneIndex16[0], matrices, pos, normals, outPos, outNormals, first, last);
+            }
+        }
+
+        // the arrays of the geometry (pos and normals with vertexCount elements, or empty)
+        void skin(const Geometry &geometry, const aRibeiro::mat4 *matrices,
+                  aRibeiro::aligned_vector<aRibeiro::vec3> *outPos, aRibeiro::aligned_vector<aRibeiro::vec3> *outNormals)const {
+            ARIBEIRO_ABORT(geometry.vertexCount != vertexCount, "SkinWeights: vertex count of another geometry.\n");
+            bool hasPos = geometry.pos.size() == vertexCount && outPos != NULL;
+            bool hasNormals = geometry.normals.size() == vertexCount && outNormals != NULL;
+            if (hasPos)
+                outPos->resize(vertexCount);
+            if (hasNormals)
+                outNormals->resize(vertexCount);
+            if (vertexCount == 0)
+                return;
+            skin(hasPos ? &geometry.pos[0] : NULL, hasNormals ? &geometry.normals[0] : NULL, matrices,
+                 hasPos ? &(*outPos)[0] : NULL, hasNormals ? &(*outNormals)[0] : NULL);
+        }
+
+        SSE2_CLASS_NEW_OPERATOR
+    }_SSE2_ALIGN_POS;
+
+}
+
+#endif
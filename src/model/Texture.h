@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     enum TextureType
@@ -114,24 +116,24 @@ namespace model {
         
         int uvIndex;
 
+        template <typename V>
+        void fields(V &v) {
+            v.name("filename", filename);
+            v.name("fileext", fileext);
+            v.enum8("type", type);
+            v.enum8("op", op);
+            v.enum8("mapMode", mapMode);
+            v.pod("uvIndex", uvIndex);
+        }
+
         void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeString(filename);
-            writer->writeString(fileext);
-            writer->writeUInt8(type);
-            writer->writeUInt8(op);
-            writer->writeUInt8(mapMode);
-            writer->writeUInt32(uvIndex);
+            ModelFields_Write(writer, *this);
         }
 
         void read(aRibeiro::BinaryReader* reader) {
-            filename = reader->readString();
-            fileext = reader->readString();
-            type = (TextureType)reader->readUInt8();
-            op = (TextureOp)reader->readUInt8();
-            mapMode = (TextureMapMode)reader->readUInt8();
-            uvIndex = reader->readUInt32();
+            ModelFields_Read(reader, this);
         }
-
+        
         Texture() {
             type = TextureType_NONE;
             op = TextureOp_Multiply;
@@ -7,6 +7,8 @@
 #include <vector>
 #include <map>
 
+#include "ModelFields.h"
+
 namespace model {
 
     class _SSE2_ALIGN_PRE Vec3Key{
@@ -14,14 +16,18 @@ namespace model {
         float time;
         aRibeiro::vec3 value;
         
+        template <typename V>
+        void fields(V &v) {
+            v.pod("time", time);
+            v.pod("value", value);
+        }
+
         void write(aRibeiro::BinaryWriter* writer)const {
-            writer->writeFloat(time);
-            writer->writeVec3(value);
+            ModelFields_Write(writer, *this);
         }
         
         void read(aRibeiro::BinaryReader* reader) {
-            time = reader->readFloat();
-            value = reader->readVec3();
+            ModelFields_Read(reader, this);
         }
         
         SSE2_CLASS_NEW_OPERATOR
@@ -0,0 +1,377 @@
+#ifndef model_vertex_builder_h_
+#define model_vertex_builder_h_
+
+#include <aRibeiroCore/aRibeiroCore.h>
+#include <vector>
+#include <string.h> // memcpy
+#include <math.h>
+
+#include "Geometry.h"
+#include "GeometryView.h"
+#include "GeometryQuantization.h"
+
+namespace model {
+
+    // Interleaved vertex buffer from the geometry arrays.
+    //
+    // The Geometry keeps one array for each attribute. The VertexLayout selects
+    // the attributes from a format mask (CONTAINS_POS | CONTAINS_NORMAL | ...),
+    // computes the offsets and the stride, and the VertexBuilder packs the
+    // arrays into one interleaved vertex stream.
+    //
+    // The attributes can be compressed to smaller types:
+    //
+    //   VertexCompress_PosHalf: position as 4 half floats (w = 1)
+    //   VertexCompress_NormalSNorm8: normal, tangent and binormal as 4 signed bytes (w = 0)
+    //   VertexCompress_NormalSNorm16: normal, tangent and binormal as 4 signed shorts (w = 0)
+    //   VertexCompress_UVHalf: uv as 2 half floats
+    //   VertexCompress_ColorUNorm8: color as 4 unsigned bytes
+    //
+    // Example:
+    //
+    //   model::VertexLayout layout(geometry.format & (CONTAINS_POS | CONTAINS_NORMAL | CONTAINS_UV0),
+    //                              model::VertexCompress_NormalSNorm8 | model::VertexCompress_UVHalf);
+    //
+    //   std::vector<uint8_t> vertices;
+    //   model::VertexBuilder::build(geometry, layout, &vertices);
+    //
+    //   const model::VertexAttrib *normal = layout.find(CONTAINS_NORMAL);
+    //   glVertexAttribPointer(1, normal->components, GL_BYTE, normal->normalized, layout.stride, (void*)(size_t)normal->offset);
+    //
+
+    enum VertexAttribType {
+        VertexAttribType_Float = 0, // 32 bits float
+        VertexAttribType_Half = 1, // 16 bits float
+        VertexAttribType_SNorm8 = 2, // [-1..1] in a signed byte
+        VertexAttribType_SNorm16 = 3, // [-1..1] in a signed short
+        VertexAttribType_UNorm8 = 4 // [0..1] in an unsigned byte
+    };
+
+    const uint32_t VertexCompress_None = 0;
+    const uint32_t VertexCompress_PosHalf = (1 << 0);
+    const uint32_t VertexCompress_NormalSNorm8 = (1 << 1);
+    const uint32_t VertexCompress_NormalSNorm16 = (1 << 2);
+    const uint32_t VertexCompress_UVHalf = (1 << 3);
+    const uint32_t VertexCompress_ColorUNorm8 = (1 << 4);
+
+    static inline size_t VertexAttribTypeSize(VertexAttribType type) {
+        switch (type) {
+            case VertexAttribType_Float: return 4;
+            case VertexAttribType_Half: return 2;
+            case VertexAttribType_SNorm8: return 1;
+            case VertexAttribType_SNorm16: return 2;
+            case VertexAttribType_UNorm8: return 1;
+        }
+        return 0;
+    }
+
+    struct VertexAttrib {
+        uint32_t flag; // CONTAINS_POS, CONTAINS_NORMAL, ...
+        VertexAttribType type;
+        uint32_t components;
+        uint32_t offset;
+        bool normalized; // the integer types are read as normalized floats (glVertexAttribPointer)
+    };
+
+    class VertexLayout {
+    public:
+        static const int MaxAttribs = 20; // pos, normal, tangent, binormal, uv[8], color[8]
+
+        uint32_t format;
+        uint32_t compression;
+        uint32_t stride;
+
+        VertexAttrib attribs[MaxAttribs];
+        int attribCount;
+
+        VertexLayout() {
+            set(0, VertexCompress_None);
+        }
+
+        VertexLayout(uint32_t format, uint32_t compression = VertexCompress_None) {
+            set(format, compression);
+        }
+
+        // the attributes in the geometry order: pos, normal, tangent, binormal, uv[8], color[8]
+        void set(uint32_t format, uint32_t compression) {
+            this->format = format;
+            this->compression = compression;
+            attribCount = 0;
+            stride = 0;
+
+            VertexAttribType normalType = VertexAttribType_Float;
+            uint32_t normalComponents = 3;
+            if (compression & VertexCompress_NormalSNorm8) {
+                normalType = VertexAttribType_SNorm8;
+                normalComponents = 4;
+            } else if (compression & VertexCompress_NormalSNorm16) {
+                normalType = VertexAttribType_SNorm16;
+                normalComponents = 4;
+            }
+
+            if (compression & VertexCompress_PosHalf)
+                add(CONTAINS_POS, VertexAttribType_Half, 4);
+            else
+                add(CONTAINS_POS, VertexAttribType_Float, 3);
+            add(CONTAINS_NORMAL, normalType, normalComponents);
+            add(CONTAINS_TANGENT, normalType, normalComponents);
+            add(CONTAINS_BINORMAL, normalType, normalComponents);
+            for (int i = 0; i < 8; i++)
+                add(CONTAINS_UV0 << i, (compression & VertexCompress_UVHalf) ? VertexAttribType_Half : VertexAttribType_Float, 2);
+            for (int i = 0; i < 8; i++)
+                add(CONTAINS_COLOR0 << i, (compression & VertexCompress_ColorUNorm8) ? VertexAttribType_UNorm8 : VertexAttribType_Float, 4);
+
+            // 4 bytes aligned vertex (required by most GPUs)
+            stride = (stride + 3) & ~3;
+        }
+
+        const VertexAttrib* find(uint32_t flag)const {
+            for (int i = 0; i < attribCount; i++)
+                if (attribs[i].flag == flag)
+                    return &attribs[i];
+            return NULL;
+        }
+
+    private:
+        void add(uint32_t flag, VertexAttribType type, uint32_t components) {
+            if (!(format & flag))
+                return;
+            // each attribute aligned to its own type size
+            size_t typeSize = VertexAttribTypeSize(type);
+            stride = (uint32_t)((stride + typeSize - 1) / typeSize * typeSize);
+
+            VertexAttrib &attrib = attribs[attribCount++];
+            attrib.flag = flag;
+            attrib.type = type;
+            attrib.components = components;
+            attrib.offset = stride;
+            attrib.normalized = (type != VertexAttribType_Float && type != VertexAttribType_Half);
+
+            stride += (uint32_t)(typeSize * components);
+        }
+    };
+
+    class VertexBuilder {
+
+        // the geometry arrays, from a Geometry or a GeometryView
+        struct Source {
+            const void *data[VertexLayout::MaxAttribs];
+            uint32_t count[VertexLayout::MaxAttribs];
+            size_t elementSize[VertexLayout::MaxAttribs];
+            uint32_t components[VertexLayout::MaxAttribs];
+            uint32_t vertexCount;
+        };
+
+        static void setSource(Source *source, int i, const void *data, uint32_t count, size_t elementSize) {
+            source->data[i] = (count > 0) ? data : NULL;
+            source->count[i] = (data != NULL) ? count : 0;
+            source->elementSize[i] = elementSize;
+            // pos, normal, tangent and binormal: xyz, uv: xy, color: rgba
+            source->components[i] = (i < 4) ? 3 : ((i < 12) ? 2 : 4);
+        }
+
+        // index of an attribute flag in the geometry order
+        static int sourceIndex(uint32_t flag) {
+            const uint32_t flags[4] = { CONTAINS_POS, CONTAINS_NORMAL, CONTAINS_TANGENT, CONTAINS_BINORMAL };
+            for (int i = 0; i < 4; i++)
+                if (flags[i] == flag)
+                    return i;
+            for (int i = 0; i < 8; i++) {
+                if ((CONTAINS_UV0 << i) == flag)
+                    return 4 + i;
+                if ((CONTAINS_COLOR0 << i) == flag)
+                    return 12 + i;
+            }
+            return -1;
+        }
+
+        // the packers read 4 floats
+        static void packFloat(const float *src, uint32_t components, uint8_t *dst) {
+            // constant size copies: a variable memcpy per vertex is a library call
+            switch (components) {
+                case 2: memcpy(dst, src, 2 * sizeof(float)); break;
+                case 3: memcpy(dst, src, 3 * sizeof(float)); break;
+                default: memcpy(dst, src, 4 * sizeof(float)); break;
+            }
+        }
+
+        static void packHalf(const float *src, uint32_t components, uint8_t *dst) {
+#if defined(ARIBEIRO_SSE2)
+            __m128i half = _mm_packs_epi32(GeometryQuantization::floatToHalf4(_mm_loadu_ps(src)), _mm_setzero_si128());
+            if (components == 2) {
+                int32_t out = _mm_cvtsi128_si32(half);
+                memcpy(dst, &out, 2 * sizeof(uint16_t));
+            } else
+                _mm_storel_epi64((__m128i *)dst, half);
+#else
+            uint16_t out[4];
+            for (uint32_t i = 0; i < components; i++)
+                out[i] = GeometryQuantization::floatToHalf(src[i]);
+            memcpy(dst, out, components * sizeof(uint16_t));
+#endif
+        }
+
+        // normals: xyz and w = 0
+        static void packSNorm8(const float *src, uint8_t *dst) {
+#if defined(ARIBEIRO_SSE2)
+            __m128 v = _mm_setr_ps(src[0], src[1], src[2], 0.0f);
+            v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+            __m128i i32 = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(127.0f)));
+            __m128i i16 = _mm_packs_epi32(i32, i32);
+            __m128i i8 = _mm_packs_epi16(i16, i16);
+            int32_t out = _mm_cvtsi128_si32(i8);
+            memcpy(dst, &out, 4);
+#else
+            for (int i = 0; i < 3; i++)
+                dst[i] = (uint8_t)(int8_t)GeometryQuantization::floatToNorm(src[i], -1.0f, 127.0f);
+            dst[3] = 0;
+#endif
+        }
+
+        static void packSNorm16(const float *src, uint8_t *dst) {
+#if defined(ARIBEIRO_SSE2)
+            __m128 v = _mm_setr_ps(src[0], src[1], src[2], 0.0f);
+            v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+            __m128i i32 = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(32767.0f)));
+            __m128i i16 = _mm_packs_epi32(i32, i32);
+            _mm_storel_epi64((__m128i *)dst, i16);
+#else
+            int16_t out[4];
+            for (int i = 0; i < 3; i++)
+                out[i] = (int16_t)GeometryQuantization::floatToNorm(src[i], -1.0f, 32767.0f);
+            out[3] = 0;
+            memcpy(dst, out, sizeof(out));
+#endif
+        }
+
+        static void packUNorm8(const float *src, uint8_t *dst) {
+#if defined(ARIBEIRO_SSE2)
+            __m128 v = _mm_loadu_ps(src);
+            v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i i32 = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.0f)));
+            __m128i i16 = _mm_packs_epi32(i32, i32);
+            __m128i u8 = _mm_packus_epi16(i16, i16);
+            int32_t out = _mm_cvtsi128_si32(u8);
+            memcpy(dst, &out, 4);
+#else
+            for (int i = 0; i < 4; i++)
+                dst[i] = (uint8_t)GeometryQuantization::floatToNorm(src[i], 0.0f, 255.0f);
+#endif
+        }
+
+        template <int Type>
+        static void pack(const float *src, uint32_t components, uint8_t *dst) {
+            switch (Type) {
+                case VertexAttribType_Float: packFloat(src, components, dst); break;
+                case VertexAttribType_Half: packHalf(src, components, dst); break;
+                case VertexAttribType_SNorm8: packSNorm8(src, dst); break;
+                case VertexAttribType_SNorm16: packSNorm16(src, dst); break;
+                case VertexAttribType_UNorm8: packUNorm8(src, dst); break;
+            }
+        }
+
+        // pack one attribute of the vertices [first..last) to the strided output
+        template <int Type>
+        static void packRange(const VertexAttrib &attrib, const Source &source, int s, uint32_t first, uint32_t last, uint8_t *dst, uint32_t stride) {
+            const uint8_t *data = (const uint8_t *)source.data[s];
+            size_t elementSize = source.elementSize[s];
+            // pos w = 1, normals w = 0 (from the packer), the uv packers use only xy
+            bool setW = (source.components[s] == 3);
+            uint32_t count = (last < source.count[s]) ? last : source.count[s];
+            float in[4] = { 0, 0, 0, 1 };
+            uint32_t v = first;
+            if (elementSize >= 4 * sizeof(float)) {
+                // vec3 with the SSE2 padding and vec4: one 16 bytes load
+                for (; v < count; v++, dst += stride) {
+                    memcpy(in, data + (size_t)v * elementSize, 4 * sizeof(float));
+                    if (setW)
+                        in[3] = 1.0f;
+                    pack<Type>(in, attrib.components, dst);
+                }
+            } else {
+                for (; v < count; v++, dst += stride) {
+                    memcpy(in, data + (size_t)v * elementSize, 3 * sizeof(float));
+                    pack<Type>(in, attrib.components, dst);
+                }
+            }
+            // missing elements are zero
+            in[0] = in[1] = in[2] = 0;
+            in[3] = setW ? 1.0f : 0.0f;
+            for (; v < last; v++, dst += stride)
+                pack<Type>(in, attrib.components, dst);
+        }
+
+        static void build(const Source &source, const VertexLayout &layout, uint8_t *output) {
+            // vertex blocks: the output block stays in the cache while each attribute is packed into it
+            const int blockSize = 64;
+            int blockCount = (int)((source.vertexCount + blockSize - 1) / blockSize);
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) if (blockCount > 64)
+#endif
+            for (int block = 0; block < blockCount; block++) {
+                uint32_t first = (uint32_t)block * blockSize;
+                uint32_t last = (first + blockSize < source.vertexCount) ? first + blockSize : source.vertexCount;
+                for (int a = 0; a < layout.attribCount; a++) {
+                    const VertexAttrib &attrib = layout.attribs[a];
+                    int s = sourceIndex(attrib.flag);
+                    uint8_t *dst = output + (size_t)first * layout.stride + attrib.offset;
+                    switch (attrib.type) {
+                        case VertexAttribType_Float: packRange<VertexAttribType_Float>(attrib, source, s, first, last, dst, layout.stride); break;
+                        case VertexAttribType_Half: packRange<VertexAttribType_Half>(attrib, source, s, first, last, dst, layout.stride); break;
+                        case VertexAttribType_SNorm8: packRange<VertexAttribType_SNorm8>(attrib, source, s, first, last, dst, layout.stride); break;
+                        case VertexAttribType_SNorm16: packRange<VertexAttribType_SNorm16>(attrib, source, s, first, last, dst, layout.stride); break;
+                        case VertexAttribType_UNorm8: packRange<VertexAttribType_UNorm8>(attrib, source, s, first, last, dst, layout.stride); break;
+                    }
+                }
+            }
+        }
+
+    public:
+
+        // vertex count: geometry.vertexCount (the missing elements of the arrays are zero)
+        static void build(const Geometry &geometry, const VertexLayout &layout, uint8_t *output) {
+            Source source;
+            source.vertexCount = geometry.vertexCount;
+            setSource(&source, 0, (geometry.pos.size() > 0) ? &geometry.pos[0] : NULL, (uint32_t)geometry.pos.size(), sizeof(aRibeiro::vec3));
+            setSource(&source, 1, (geometry.normals.size() > 0) ? &geometry.normals[0] : NULL, (uint32_t)geometry.normals.size(), sizeof(aRibeiro::vec3));
+            setSource(&source, 2, (geometry.tangent.size() > 0) ? &geometry.tangent[0] : NULL, (uint32_t)geometry.tangent.size(), sizeof(aRibeiro::vec3));
+            setSource(&source, 3, (geometry.binormal.size() > 0) ? &geometry.binormal[0] : NULL, (uint32_t)geometry.binormal.size(), sizeof(aRibeiro::vec3));
+            for (int i = 0; i < 8; i++) {
+                setSource(&source, 4 + i, (geometry.uv[i].size() > 0) ? &geometry.uv[i][0] : NULL, (uint32_t)geometry.uv[i].size(), sizeof(aRibeiro::vec3));
+                setSource(&source, 12 + i, (geometry.color[i].size() > 0) ? &geometry.color[i][0] : NULL, (uint32_t)geometry.color[i].size(), sizeof(aRibeiro::vec4));
+            }
+            build(source, layout, output);
+        }
+
+        static void build(const GeometryView &view, const VertexLayout &layout, uint8_t *output) {
+            Source source;
+            source.vertexCount = view.vertexCount;
+            setSource(&source, 0, view.pos, view.posCount, sizeof(aRibeiro::vec3));
+            setSource(&source, 1, view.normals, view.normalsCount, sizeof(aRibeiro::vec3));
+            setSource(&source, 2, view.tangent, view.tangentCount, sizeof(aRibeiro::vec3));
+            setSource(&source, 3, view.binormal, view.binormalCount, sizeof(aRibeiro::vec3));
+            for (int i = 0; i < 8; i++) {
+                setSource(&source, 4 + i, view.uv[i], view.uvCount[i], sizeof(aRibeiro::vec3));
+                setSource(&source, 12 + i, view.color[i], view.colorCount[i], sizeof(aRibeiro::vec4));
+            }
+            build(source, layout, output);
+        }
+
+        static void build(const Geometry &geometry, const VertexLayout &layout, std::vector<uint8_t> *output) {
+            output->resize((size_t)geometry.vertexCount * layout.stride);
+            if (output->size() > 0)
+                build(geometry, layout, &(*output)[0]);
+        }
+
+        static void build(const GeometryView &view, const VertexLayout &layout, std::vector<uint8_t> *output) {
+            output->resize((size_t)view.vertexCount * layout.stride);
+            if (output->size() > 0)
+                build(view, layout, &(*output)[0]);
+        }
+
+    };
+
+}
+
+#endif